@@ -0,0 +1,501 @@
+/*
+ * Compile:  mpicc -O3 -march=native mpi_mat_vect_mult.c -o mpi_mat_vect_mult -lm
+ * Run:      mpiexec -n N ./mpi_mat_vect_mult
+ *
+ * Dense matrix-vector multiplication y = A*x and rank-1 update
+ * A = A + alpha*u*v^T on top of the block distributed vectors.  A is
+ * distributed by blocks of rows:  each process stores local_m = m/comm_sz
+ * consecutive rows in row-major order, and x, y, u and v are block
+ * distributed like the vectors in mpi_vector_add.c.
+ *
+ * Mat_vect_mult gathers x onto every process with MPI_Allgather before
+ * the local multiply.  Mat_vect_mult_ring instead passes the blocks of
+ * x around a ring and multiplies with the block it already has while
+ * the next one is in flight.  The local kernels work on column strips
+ * of GEMV_COL_BLOCK entries so the strip of x stays in cache, handle
+ * four rows at a time so each element of x is loaded once for four
+ * rows, and keep GEMV_LANES independent partial sums per row so the
+ * compiler can use SIMD instructions without reassociating the sums
+ * itself.
+ *
+ * The program prints the largest difference between the results of
+ * the two multiplies, which sum the columns in different orders, and
+ * the GFLOP/s of both multiplies and the rank-1 update next to the
+ * level-1 vector sum and dot product.  The level-1 kernels work on
+ * vectors with as many elements as the matrix (the local rows of A
+ * are one operand), so they move the same number of bytes and take
+ * long enough to be timed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <mpi.h>
+
+#define GEMV_COL_BLOCK 2048
+#define GEMV_LANES 4
+#define BENCH_REPS 10
+
+void Check_for_error(int local_ok, char fname[], char message[],
+                     MPI_Comm comm);
+void Read_dimensions(int *m_p, int *local_m_p, int *n_p, int *local_n_p,
+                     int my_rank, int comm_sz, MPI_Comm comm);
+void Allocate_arrays(double **local_A_pp, double **local_x_pp,
+                     double **local_y_pp, double **x_pp, int local_m,
+                     int n, int local_n, MPI_Comm comm);
+void Generate_random_vector(double local_a[], int local_n);
+void Print_vector(double local_b[], int local_n, int n, char title[],
+                  int my_rank, MPI_Comm comm);
+void Local_gemv(double A[], int lda, double x[], double y[], int rows,
+                int cols);
+void Mat_vect_mult(double local_A[], double local_x[], double local_y[],
+                   double x[], int local_m, int n, int local_n,
+                   MPI_Comm comm);
+void Mat_vect_mult_ring(double local_A[], double local_x[],
+                        double local_y[], double x[], int local_m, int n,
+                        int local_n, MPI_Comm comm);
+void Rank1_update(double local_A[], double alpha, double local_u[],
+                  double local_v[], double v[], int local_m, int n,
+                  int local_n, MPI_Comm comm);
+void Parallel_vector_sum(double local_x[], double local_y[],
+                         double local_z[], int local_n);
+double Parallel_dot(double local_x[], double local_y[], int local_n,
+                    MPI_Comm comm);
+double Max_difference(double local_a[], double local_b[], int local_n,
+                      MPI_Comm comm);
+void Print_gflops(char title[], double flops, double elapsed, int my_rank,
+                  MPI_Comm comm);
+
+/*-------------------------------------------------------------------*/
+int main(void)
+{
+    int m, local_m, n, local_n, rep;
+    int comm_sz, my_rank;
+    double *local_A, *local_x, *local_y, *x, *local_u, *local_z;
+    double *local_y_ring;
+    MPI_Comm comm;
+    double tstart, diff;
+
+    MPI_Init(NULL, NULL);
+    comm = MPI_COMM_WORLD;
+    MPI_Comm_size(comm, &comm_sz);
+    MPI_Comm_rank(comm, &my_rank);
+
+    Read_dimensions(&m, &local_m, &n, &local_n, my_rank, comm_sz, comm);
+    srand(time(NULL) + my_rank);
+    Allocate_arrays(&local_A, &local_x, &local_y, &x, local_m, n, local_n,
+                    comm);
+    local_u = malloc(local_m * sizeof(double));
+    local_y_ring = malloc(local_m * sizeof(double));
+    /* Level-1 operand as large as the local rows of A */
+    local_z = malloc((size_t)local_m * n * sizeof(double));
+    Check_for_error(local_u != NULL && local_y_ring != NULL &&
+                    local_z != NULL, "main",
+                    "Can't allocate local vector(s)", comm);
+
+    Generate_random_vector(local_A, local_m * n);
+    Generate_random_vector(local_x, local_n);
+    Generate_random_vector(local_u, local_m);
+    memset(local_z, 0, (size_t)local_m * n * sizeof(double));
+
+    Mat_vect_mult(local_A, local_x, local_y, x, local_m, n, local_n, comm);
+    Print_vector(local_y, local_m, m, "y = A*x is", my_rank, comm);
+    Mat_vect_mult_ring(local_A, local_x, local_y_ring, x, local_m, n,
+                       local_n, comm);
+    Print_vector(local_y_ring, local_m, m, "y = A*x with the ring is",
+                 my_rank, comm);
+    diff = Max_difference(local_y, local_y_ring, local_m, comm);
+    if (my_rank == 0)
+        printf("max |y_ring - y_allgather| = %.3e\n\n", diff);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    for (rep = 0; rep < BENCH_REPS; rep++)
+        Mat_vect_mult(local_A, local_x, local_y, x, local_m, n, local_n,
+                      comm);
+    Print_gflops("GEMV, Allgather", 2.0 * m * n * BENCH_REPS,
+                 MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    for (rep = 0; rep < BENCH_REPS; rep++)
+        Mat_vect_mult_ring(local_A, local_x, local_y, x, local_m, n,
+                           local_n, comm);
+    Print_gflops("GEMV, ring     ", 2.0 * m * n * BENCH_REPS,
+                 MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    for (rep = 0; rep < BENCH_REPS; rep++)
+        Rank1_update(local_A, 1.0e-3, local_u, local_x, x, local_m, n,
+                     local_n, comm);
+    Print_gflops("Rank-1 update  ", 2.0 * m * n * BENCH_REPS,
+                 MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    for (rep = 0; rep < BENCH_REPS; rep++)
+        Parallel_vector_sum(local_A, local_A, local_z, local_m * n);
+    Print_gflops("Vector sum     ", (double)m * n * BENCH_REPS,
+                 MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    for (rep = 0; rep < BENCH_REPS; rep++)
+        Parallel_dot(local_A, local_z, local_m * n, comm);
+    Print_gflops("Dot product    ", 2.0 * m * n * BENCH_REPS,
+                 MPI_Wtime() - tstart, my_rank, comm);
+
+    free(local_A);
+    free(local_x);
+    free(local_y);
+    free(x);
+    free(local_u);
+    free(local_y_ring);
+    free(local_z);
+
+    MPI_Finalize();
+
+    return 0;
+} /* main */
+
+void Check_for_error(
+    int local_ok /* in */,
+    char fname[] /* in */,
+    char message[] /* in */,
+    MPI_Comm comm /* in */)
+{
+    int ok;
+
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (ok == 0)
+    {
+        int my_rank;
+        MPI_Comm_rank(comm, &my_rank);
+        if (my_rank == 0)
+        {
+            fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+                    message);
+            fflush(stderr);
+        }
+        MPI_Finalize();
+        exit(-1);
+    }
+} /* Check_for_error */
+
+void Read_dimensions(
+    int *m_p /* out */,
+    int *local_m_p /* out */,
+    int *n_p /* out */,
+    int *local_n_p /* out */,
+    int my_rank /* in  */,
+    int comm_sz /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Read_dimensions";
+
+    if (my_rank == 0)
+    {
+        printf("Enter the number of rows\n");
+        scanf("%d", m_p);
+        printf("Enter the number of columns\n");
+        scanf("%d", n_p);
+    }
+    MPI_Bcast(m_p, 1, MPI_INT, 0, comm);
+    MPI_Bcast(n_p, 1, MPI_INT, 0, comm);
+    if (*m_p <= 0 || *n_p <= 0 || *m_p % comm_sz != 0 ||
+        *n_p % comm_sz != 0)
+        local_ok = 0;
+    Check_for_error(local_ok, fname,
+                    "m and n should be > 0 and evenly divisible by comm_sz",
+                    comm);
+    *local_m_p = *m_p / comm_sz;
+    *local_n_p = *n_p / comm_sz;
+} /* Read_dimensions */
+
+void Allocate_arrays(
+    double **local_A_pp /* out */,
+    double **local_x_pp /* out */,
+    double **local_y_pp /* out */,
+    double **x_pp /* out */,
+    int local_m /* in  */,
+    int n /* in  */,
+    int local_n /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Allocate_arrays";
+
+    *local_A_pp = malloc((size_t)local_m * n * sizeof(double));
+    *local_x_pp = malloc(local_n * sizeof(double));
+    *local_y_pp = malloc(local_m * sizeof(double));
+    /* Mat_vect_mult_ring needs room for two blocks of x */
+    *x_pp = malloc((n < 2 * local_n ? 2 * local_n : n) * sizeof(double));
+
+    if (*local_A_pp == NULL || *local_x_pp == NULL ||
+        *local_y_pp == NULL || *x_pp == NULL)
+        local_ok = 0;
+    Check_for_error(local_ok, fname, "Can't allocate local arrays",
+                    comm);
+} /* Allocate_arrays */
+
+void Generate_random_vector(
+    double local_a[] /* out */,
+    int local_n /* in  */)
+{
+    int i;
+
+    for (i = 0; i < local_n; i++)
+        local_a[i] = (double)rand() / (double)RAND_MAX;
+} /* Generate_random_vector */
+
+void Print_vector(
+    double local_b[] /* in */,
+    int local_n /* in */,
+    int n /* in */,
+    char title[] /* in */,
+    int my_rank /* in */,
+    MPI_Comm comm /* in */)
+{
+
+    double *b = NULL;
+    int i;
+    int local_ok = 1;
+    char *fname = "Print_vector";
+
+    if (my_rank == 0)
+    {
+        b = malloc(n * sizeof(double));
+        if (b == NULL)
+            local_ok = 0;
+        Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+                        comm);
+        MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE,
+                   0, comm);
+        printf("%s\n", title);
+        for (i = 0; i < 10 && i < n; i++)
+            printf("%.3f ", b[i]);
+
+        if (n > 20)
+            printf("... ");
+
+        for (i = n - 10; i < n; i++)
+            if (i >= 10)
+                printf("%.3f ", b[i]);
+        printf("\n");
+        free(b);
+    }
+    else
+    {
+        Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+                        comm);
+        MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE, 0,
+                   comm);
+    }
+} /* Print_vector */
+
+/* y += A*x for a rows x cols block of A with leading dimension lda */
+void Local_gemv(
+    double A[] /* in     */,
+    int lda /* in     */,
+    double x[] /* in     */,
+    double y[] /* in/out */,
+    int rows /* in     */,
+    int cols /* in     */)
+{
+    double acc[4][GEMV_LANES];
+    double *a0, *a1, *a2, *a3;
+    int jb, jend, i, j, l, r, nr;
+
+    for (jb = 0; jb < cols; jb += GEMV_COL_BLOCK)
+    {
+        jend = jb + GEMV_COL_BLOCK < cols ? jb + GEMV_COL_BLOCK : cols;
+        for (i = 0; i < rows; i += 4)
+        {
+            nr = rows - i < 4 ? rows - i : 4;
+            /* Rows past the end alias the last row and are discarded */
+            a0 = A + (size_t)i * lda;
+            a1 = A + (size_t)(i + (nr > 1 ? 1 : 0)) * lda;
+            a2 = A + (size_t)(i + (nr > 2 ? 2 : 0)) * lda;
+            a3 = A + (size_t)(i + (nr > 3 ? 3 : 0)) * lda;
+            memset(acc, 0, sizeof(acc));
+
+            for (j = jb; j + GEMV_LANES <= jend; j += GEMV_LANES)
+                for (l = 0; l < GEMV_LANES; l++)
+                {
+                    acc[0][l] += a0[j + l] * x[j + l];
+                    acc[1][l] += a1[j + l] * x[j + l];
+                    acc[2][l] += a2[j + l] * x[j + l];
+                    acc[3][l] += a3[j + l] * x[j + l];
+                }
+            for (; j < jend; j++)
+            {
+                acc[0][0] += a0[j] * x[j];
+                acc[1][0] += a1[j] * x[j];
+                acc[2][0] += a2[j] * x[j];
+                acc[3][0] += a3[j] * x[j];
+            }
+
+            for (r = 0; r < nr; r++)
+                for (l = 0; l < GEMV_LANES; l++)
+                    y[i + r] += acc[r][l];
+        }
+    }
+} /* Local_gemv */
+
+/* x is scratch storage for the full vector x */
+void Mat_vect_mult(
+    double local_A[] /* in  */,
+    double local_x[] /* in  */,
+    double local_y[] /* out */,
+    double x[] /* out */,
+    int local_m /* in  */,
+    int n /* in  */,
+    int local_n /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    MPI_Allgather(local_x, local_n, MPI_DOUBLE, x, local_n, MPI_DOUBLE,
+                  comm);
+    memset(local_y, 0, local_m * sizeof(double));
+    Local_gemv(local_A, n, x, local_y, local_m, n);
+} /* Mat_vect_mult */
+
+/*
+ * At step s the process holds the block of x that belongs to process
+ * my_rank - s (mod comm_sz).  It sends that block to the right and
+ * receives the next one from the left while it multiplies with the
+ * matching columns of local_A.  x is scratch storage for two blocks
+ * (at least 2*local_n entries).
+ */
+void Mat_vect_mult_ring(
+    double local_A[] /* in  */,
+    double local_x[] /* in  */,
+    double local_y[] /* out */,
+    double x[] /* out */,
+    int local_m /* in  */,
+    int n /* in  */,
+    int local_n /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    double *cur = x, *next = x + local_n, *tmp;
+    int comm_sz, my_rank, step, owner, left, right;
+    MPI_Request reqs[2];
+
+    MPI_Comm_size(comm, &comm_sz);
+    MPI_Comm_rank(comm, &my_rank);
+    left = (my_rank - 1 + comm_sz) % comm_sz;
+    right = (my_rank + 1) % comm_sz;
+
+    memcpy(cur, local_x, local_n * sizeof(double));
+    memset(local_y, 0, local_m * sizeof(double));
+    for (step = 0; step < comm_sz; step++)
+    {
+        owner = (my_rank - step + comm_sz) % comm_sz;
+        if (step < comm_sz - 1)
+        {
+            MPI_Irecv(next, local_n, MPI_DOUBLE, left, 0, comm, &reqs[0]);
+            MPI_Isend(cur, local_n, MPI_DOUBLE, right, 0, comm, &reqs[1]);
+        }
+        Local_gemv(local_A + (size_t)owner * local_n, n, cur, local_y,
+                   local_m, local_n);
+        if (step < comm_sz - 1)
+        {
+            MPI_Waitall(2, reqs, MPI_STATUSES_IGNORE);
+            tmp = cur;
+            cur = next;
+            next = tmp;
+        }
+    }
+} /* Mat_vect_mult_ring */
+
+/*
+ * A += alpha*u*v^T.  u is distributed like the rows of A, v like x.
+ * v is scratch storage for the full vector v.
+ */
+void Rank1_update(
+    double local_A[] /* in/out */,
+    double alpha /* in     */,
+    double local_u[] /* in     */,
+    double local_v[] /* in     */,
+    double v[] /* out    */,
+    int local_m /* in     */,
+    int n /* in     */,
+    int local_n /* in     */,
+    MPI_Comm comm /* in     */)
+{
+    double *row, scale;
+    int i, j;
+
+    MPI_Allgather(local_v, local_n, MPI_DOUBLE, v, local_n, MPI_DOUBLE,
+                  comm);
+    for (i = 0; i < local_m; i++)
+    {
+        row = local_A + (size_t)i * n;
+        scale = alpha * local_u[i];
+        for (j = 0; j < n; j++)
+            row[j] += scale * v[j];
+    }
+} /* Rank1_update */
+
+void Parallel_vector_sum(
+    double local_x[] /* in  */,
+    double local_y[] /* in  */,
+    double local_z[] /* out */,
+    int local_n /* in  */)
+{
+    int local_i;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        local_z[local_i] = local_x[local_i] + local_y[local_i];
+} /* Parallel_vector_sum */
+
+double Parallel_dot(
+    double local_x[] /* in */,
+    double local_y[] /* in */,
+    int local_n /* in */,
+    MPI_Comm comm /* in */)
+{
+    int local_i;
+    double local_dot = 0.0, dot;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        local_dot += local_x[local_i] * local_y[local_i];
+    MPI_Allreduce(&local_dot, &dot, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return dot;
+} /* Parallel_dot */
+
+/* max |a_i - b_i| over the distributed vectors */
+double Max_difference(
+    double local_a[] /* in */,
+    double local_b[] /* in */,
+    int local_n /* in */,
+    MPI_Comm comm /* in */)
+{
+    int local_i;
+    double local_max = 0.0, max;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        if (fabs(local_a[local_i] - local_b[local_i]) > local_max)
+            local_max = fabs(local_a[local_i] - local_b[local_i]);
+    MPI_Allreduce(&local_max, &max, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return max;
+} /* Max_difference */
+
+/* Print the GFLOP/s of an operation, using the slowest process' time */
+void Print_gflops(
+    char title[] /* in */,
+    double flops /* in */,
+    double elapsed /* in */,
+    int my_rank /* in */,
+    MPI_Comm comm /* in */)
+{
+    double max_elapsed;
+
+    MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    if (my_rank == 0)
+        printf("%s  %10.3f ms  %8.3f GFLOP/s\n", title,
+               max_elapsed * 1000 / BENCH_REPS, flops / max_elapsed / 1.0e9);
+} /* Print_gflops */
@@ -0,0 +1,546 @@
+/*
+ * Compile:  mpicc -O2 mpi_sparse_vector.c -o mpi_sparse_vector
+ * Run:      mpiexec -n N ./mpi_sparse_vector
+ *
+ * Sparse version of the block distributed vectors:  each process
+ * stores only the nonzeros of its block as sorted (index, value)
+ * arrays, with indices relative to the start of the block.  The
+ * program times add, dot, scale and axpy for sparse-sparse,
+ * sparse-dense and dense-dense operands, and the conversions between
+ * the sparse and the dense layouts, so that the density at which the
+ * sparse layout stops paying off can be measured.
+ *
+ * The merge kernels are written without data dependent branches so
+ * the compiler can use conditional moves/blends, and the sparse-dense
+ * kernels are plain gather/scatter loops.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <mpi.h>
+
+typedef struct
+{
+    int nnz;     /* number of stored entries               */
+    int *idx;    /* sorted indices relative to the block   */
+    double *val; /* values of the stored entries           */
+} Sparse_vector;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+                     MPI_Comm comm);
+void Read_n_density(int *n_p, int *local_n_p, double *density_p,
+                    int my_rank, int comm_sz, MPI_Comm comm);
+void Allocate_sparse_vector(Sparse_vector *v_p, int capacity,
+                            MPI_Comm comm);
+void Free_sparse_vector(Sparse_vector *v_p);
+void Allocate_vectors(double **local_x_pp, double **local_y_pp,
+                      double **local_z_pp, int local_n, MPI_Comm comm);
+void Generate_sparse_vector(Sparse_vector *v_p, double density,
+                            int local_n);
+void Dense_to_sparse(double local_a[], int local_n, Sparse_vector *v_p,
+                     MPI_Comm comm);
+void Sparse_to_dense(Sparse_vector *v_p, int local_n, double local_a[]);
+void Parallel_vector_sum(double local_x[], double local_y[],
+                         double local_z[], int local_n);
+double Parallel_dot(double local_x[], double local_y[], int local_n,
+                    MPI_Comm comm);
+void Parallel_scale(double local_x[], double alpha, int local_n);
+void Parallel_axpy(double alpha, double local_x[], double local_y[],
+                   int local_n);
+void Sparse_sparse_sum(Sparse_vector *x_p, Sparse_vector *y_p,
+                       Sparse_vector *z_p);
+void Sparse_dense_sum(Sparse_vector *x_p, double local_y[],
+                      double local_z[], int local_n);
+double Sparse_sparse_dot(Sparse_vector *x_p, Sparse_vector *y_p,
+                         MPI_Comm comm);
+double Sparse_dense_dot(Sparse_vector *x_p, double local_y[],
+                        MPI_Comm comm);
+void Sparse_scale(Sparse_vector *x_p, double alpha);
+void Sparse_sparse_axpy(double alpha, Sparse_vector *x_p,
+                        Sparse_vector *y_p, Sparse_vector *z_p);
+void Sparse_dense_axpy(double alpha, Sparse_vector *x_p,
+                       double local_y[]);
+void Print_time(char title[], double elapsed, int my_rank, MPI_Comm comm);
+
+/*-------------------------------------------------------------------*/
+int main(void)
+{
+    int n, local_n, global_nnz[2], local_nnz[2];
+    int comm_sz, my_rank;
+    double density, dot_d, dot_ss, dot_sd;
+    double *local_x, *local_y, *local_z;
+    Sparse_vector sx, sy, sz, sx_back;
+    MPI_Comm comm;
+    double tstart;
+
+    MPI_Init(NULL, NULL);
+    comm = MPI_COMM_WORLD;
+    MPI_Comm_size(comm, &comm_sz);
+    MPI_Comm_rank(comm, &my_rank);
+
+    Read_n_density(&n, &local_n, &density, my_rank, comm_sz, comm);
+    srand(time(NULL) + my_rank);
+    Allocate_vectors(&local_x, &local_y, &local_z, local_n, comm);
+
+    Allocate_sparse_vector(&sx, local_n, comm);
+    Allocate_sparse_vector(&sy, local_n, comm);
+    Generate_sparse_vector(&sx, density, local_n);
+    Generate_sparse_vector(&sy, density, local_n);
+    Allocate_sparse_vector(&sz, sx.nnz + sy.nnz, comm);
+
+    local_nnz[0] = sx.nnz;
+    local_nnz[1] = sy.nnz;
+    MPI_Reduce(local_nnz, global_nnz, 2, MPI_INT, MPI_SUM, 0, comm);
+    if (my_rank == 0)
+    {
+        printf("n = %d, nonzeros in x = %d, in y = %d\n", n,
+               global_nnz[0], global_nnz[1]);
+        printf("Dense storage per vector:  %.3f MB\n",
+               (double)n * sizeof(double) / 1.0e6);
+        printf("Sparse storage of x:       %.3f MB\n",
+               (double)global_nnz[0] * (sizeof(int) + sizeof(double)) /
+                   1.0e6);
+    }
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Sparse_to_dense(&sx, local_n, local_x);
+    Print_time("Sparse to dense", MPI_Wtime() - tstart, my_rank, comm);
+    Sparse_to_dense(&sy, local_n, local_y);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Dense_to_sparse(local_x, local_n, &sx_back, comm);
+    Print_time("Dense to sparse", MPI_Wtime() - tstart, my_rank, comm);
+    Free_sparse_vector(&sx_back);
+
+    /* Sum */
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Parallel_vector_sum(local_x, local_y, local_z, local_n);
+    Print_time("Dense  + dense  sum", MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Sparse_sparse_sum(&sx, &sy, &sz);
+    Print_time("Sparse + sparse sum", MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Sparse_dense_sum(&sx, local_y, local_z, local_n);
+    Print_time("Sparse + dense  sum", MPI_Wtime() - tstart, my_rank, comm);
+
+    /* Dot */
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    dot_d = Parallel_dot(local_x, local_y, local_n, comm);
+    Print_time("Dense  . dense  dot", MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    dot_ss = Sparse_sparse_dot(&sx, &sy, comm);
+    Print_time("Sparse . sparse dot", MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    dot_sd = Sparse_dense_dot(&sx, local_y, comm);
+    Print_time("Sparse . dense  dot", MPI_Wtime() - tstart, my_rank, comm);
+
+    if (my_rank == 0)
+        printf("Dot products:  dense %.6e, sparse %.6e, mixed %.6e\n",
+               dot_d, dot_ss, dot_sd);
+
+    /* Axpy and scale */
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Parallel_axpy(2.0, local_x, local_y, local_n);
+    Print_time("Dense  axpy dense  ", MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Sparse_sparse_axpy(2.0, &sx, &sy, &sz);
+    Print_time("Sparse axpy sparse ", MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Sparse_dense_axpy(2.0, &sx, local_y);
+    Print_time("Sparse axpy dense  ", MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Parallel_scale(local_x, 0.5, local_n);
+    Print_time("Dense  scale       ", MPI_Wtime() - tstart, my_rank, comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Sparse_scale(&sx, 0.5);
+    Print_time("Sparse scale       ", MPI_Wtime() - tstart, my_rank, comm);
+
+    Free_sparse_vector(&sx);
+    Free_sparse_vector(&sy);
+    Free_sparse_vector(&sz);
+    free(local_x);
+    free(local_y);
+    free(local_z);
+
+    MPI_Finalize();
+
+    return 0;
+} /* main */
+
+void Check_for_error(
+    int local_ok /* in */,
+    char fname[] /* in */,
+    char message[] /* in */,
+    MPI_Comm comm /* in */)
+{
+    int ok;
+
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (ok == 0)
+    {
+        int my_rank;
+        MPI_Comm_rank(comm, &my_rank);
+        if (my_rank == 0)
+        {
+            fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+                    message);
+            fflush(stderr);
+        }
+        MPI_Finalize();
+        exit(-1);
+    }
+} /* Check_for_error */
+
+void Read_n_density(
+    int *n_p /* out */,
+    int *local_n_p /* out */,
+    double *density_p /* out */,
+    int my_rank /* in  */,
+    int comm_sz /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Read_n_density";
+
+    if (my_rank == 0)
+    {
+        printf("What's the order of the vectors?\n");
+        scanf("%d", n_p);
+        printf("What fraction of the entries are nonzero (0 to 1)?\n");
+        scanf("%lf", density_p);
+    }
+    MPI_Bcast(n_p, 1, MPI_INT, 0, comm);
+    MPI_Bcast(density_p, 1, MPI_DOUBLE, 0, comm);
+    if (*n_p <= 0 || *n_p % comm_sz != 0 || *density_p < 0.0 ||
+        *density_p > 1.0)
+        local_ok = 0;
+    Check_for_error(local_ok, fname,
+                    "n should be > 0 and evenly divisible by comm_sz, "
+                    "and the density should be between 0 and 1", comm);
+    *local_n_p = *n_p / comm_sz;
+} /* Read_n_density */
+
+void Allocate_sparse_vector(
+    Sparse_vector *v_p /* out */,
+    int capacity /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Allocate_sparse_vector";
+
+    /* Allocate at least one entry so that malloc(0) isn't an error */
+    v_p->nnz = 0;
+    v_p->idx = malloc((capacity > 0 ? capacity : 1) * sizeof(int));
+    v_p->val = malloc((capacity > 0 ? capacity : 1) * sizeof(double));
+
+    if (v_p->idx == NULL || v_p->val == NULL)
+        local_ok = 0;
+    Check_for_error(local_ok, fname, "Can't allocate sparse vector",
+                    comm);
+} /* Allocate_sparse_vector */
+
+void Free_sparse_vector(Sparse_vector *v_p /* in/out */)
+{
+    free(v_p->idx);
+    free(v_p->val);
+    v_p->idx = NULL;
+    v_p->val = NULL;
+    v_p->nnz = 0;
+} /* Free_sparse_vector */
+
+void Allocate_vectors(
+    double **local_x_pp /* out */,
+    double **local_y_pp /* out */,
+    double **local_z_pp /* out */,
+    int local_n /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Allocate_vectors";
+
+    *local_x_pp = malloc(local_n * sizeof(double));
+    *local_y_pp = malloc(local_n * sizeof(double));
+    *local_z_pp = malloc(local_n * sizeof(double));
+
+    if (*local_x_pp == NULL || *local_y_pp == NULL ||
+        *local_z_pp == NULL)
+        local_ok = 0;
+    Check_for_error(local_ok, fname, "Can't allocate local vector(s)",
+                    comm);
+} /* Allocate_vectors */
+
+/* v_p must have room for local_n entries */
+void Generate_sparse_vector(
+    Sparse_vector *v_p /* out */,
+    double density /* in  */,
+    int local_n /* in  */)
+{
+    int i;
+
+    v_p->nnz = 0;
+    for (i = 0; i < local_n; i++)
+        if ((double)rand() / ((double)RAND_MAX + 1.0) < density)
+        {
+            v_p->idx[v_p->nnz] = i;
+            v_p->val[v_p->nnz] = (double)rand() / (double)RAND_MAX;
+            v_p->nnz++;
+        }
+} /* Generate_sparse_vector */
+
+/* Allocates v_p with exactly as many entries as local_a has nonzeros */
+void Dense_to_sparse(
+    double local_a[] /* in  */,
+    int local_n /* in  */,
+    Sparse_vector *v_p /* out */,
+    MPI_Comm comm /* in  */)
+{
+    int i, count = 0;
+
+    for (i = 0; i < local_n; i++)
+        count += local_a[i] != 0.0;
+    Allocate_sparse_vector(v_p, count, comm);
+
+    for (i = 0; i < local_n; i++)
+        if (local_a[i] != 0.0)
+        {
+            v_p->idx[v_p->nnz] = i;
+            v_p->val[v_p->nnz] = local_a[i];
+            v_p->nnz++;
+        }
+} /* Dense_to_sparse */
+
+void Sparse_to_dense(
+    Sparse_vector *v_p /* in  */,
+    int local_n /* in  */,
+    double local_a[] /* out */)
+{
+    int k;
+
+    memset(local_a, 0, local_n * sizeof(double));
+    for (k = 0; k < v_p->nnz; k++)
+        local_a[v_p->idx[k]] = v_p->val[k];
+} /* Sparse_to_dense */
+
+void Parallel_vector_sum(
+    double local_x[] /* in  */,
+    double local_y[] /* in  */,
+    double local_z[] /* out */,
+    int local_n /* in  */)
+{
+    int local_i;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        local_z[local_i] = local_x[local_i] + local_y[local_i];
+} /* Parallel_vector_sum */
+
+double Parallel_dot(
+    double local_x[] /* in */,
+    double local_y[] /* in */,
+    int local_n /* in */,
+    MPI_Comm comm /* in */)
+{
+    int local_i;
+    double local_dot = 0.0, dot;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        local_dot += local_x[local_i] * local_y[local_i];
+    MPI_Allreduce(&local_dot, &dot, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return dot;
+} /* Parallel_dot */
+
+void Parallel_scale(
+    double local_x[] /* in/out */,
+    double alpha /* in     */,
+    int local_n /* in     */)
+{
+    int local_i;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        local_x[local_i] *= alpha;
+} /* Parallel_scale */
+
+void Parallel_axpy(
+    double alpha /* in     */,
+    double local_x[] /* in     */,
+    double local_y[] /* in/out */,
+    int local_n /* in     */)
+{
+    int local_i;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        local_y[local_i] += alpha * local_x[local_i];
+} /* Parallel_axpy */
+
+/* z = x + y.  z_p must have room for x_p->nnz + y_p->nnz entries. */
+void Sparse_sparse_sum(
+    Sparse_vector *x_p /* in  */,
+    Sparse_vector *y_p /* in  */,
+    Sparse_vector *z_p /* out */)
+{
+    int i = 0, j = 0, k = 0;
+    int a, b, take_x, take_y;
+
+    while (i < x_p->nnz && j < y_p->nnz)
+    {
+        a = x_p->idx[i];
+        b = y_p->idx[j];
+        take_x = a <= b;
+        take_y = b <= a;
+        z_p->idx[k] = take_x ? a : b;
+        z_p->val[k] = (take_x ? x_p->val[i] : 0.0) +
+                      (take_y ? y_p->val[j] : 0.0);
+        i += take_x;
+        j += take_y;
+        k++;
+    }
+    memcpy(z_p->idx + k, x_p->idx + i, (x_p->nnz - i) * sizeof(int));
+    memcpy(z_p->val + k, x_p->val + i, (x_p->nnz - i) * sizeof(double));
+    k += x_p->nnz - i;
+    memcpy(z_p->idx + k, y_p->idx + j, (y_p->nnz - j) * sizeof(int));
+    memcpy(z_p->val + k, y_p->val + j, (y_p->nnz - j) * sizeof(double));
+    k += y_p->nnz - j;
+    z_p->nnz = k;
+} /* Sparse_sparse_sum */
+
+/* z = x + y with x sparse and y, z dense */
+void Sparse_dense_sum(
+    Sparse_vector *x_p /* in  */,
+    double local_y[] /* in  */,
+    double local_z[] /* out */,
+    int local_n /* in  */)
+{
+    int k;
+
+    if (local_z != local_y)
+        memcpy(local_z, local_y, local_n * sizeof(double));
+    for (k = 0; k < x_p->nnz; k++)
+        local_z[x_p->idx[k]] += x_p->val[k];
+} /* Sparse_dense_sum */
+
+double Sparse_sparse_dot(
+    Sparse_vector *x_p /* in */,
+    Sparse_vector *y_p /* in */,
+    MPI_Comm comm /* in */)
+{
+    int i = 0, j = 0;
+    int a, b;
+    double local_dot = 0.0, dot;
+
+    while (i < x_p->nnz && j < y_p->nnz)
+    {
+        a = x_p->idx[i];
+        b = y_p->idx[j];
+        local_dot += a == b ? x_p->val[i] * y_p->val[j] : 0.0;
+        i += a <= b;
+        j += b <= a;
+    }
+    MPI_Allreduce(&local_dot, &dot, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return dot;
+} /* Sparse_sparse_dot */
+
+double Sparse_dense_dot(
+    Sparse_vector *x_p /* in */,
+    double local_y[] /* in */,
+    MPI_Comm comm /* in */)
+{
+    int k;
+    double local_dot = 0.0, dot;
+
+    for (k = 0; k < x_p->nnz; k++)
+        local_dot += x_p->val[k] * local_y[x_p->idx[k]];
+    MPI_Allreduce(&local_dot, &dot, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return dot;
+} /* Sparse_dense_dot */
+
+void Sparse_scale(
+    Sparse_vector *x_p /* in/out */,
+    double alpha /* in     */)
+{
+    int k;
+
+    for (k = 0; k < x_p->nnz; k++)
+        x_p->val[k] *= alpha;
+} /* Sparse_scale */
+
+/* z = alpha*x + y.  z_p must have room for x_p->nnz + y_p->nnz entries. */
+void Sparse_sparse_axpy(
+    double alpha /* in  */,
+    Sparse_vector *x_p /* in  */,
+    Sparse_vector *y_p /* in  */,
+    Sparse_vector *z_p /* out */)
+{
+    int i = 0, j = 0, k = 0;
+    int a, b, take_x, take_y;
+
+    while (i < x_p->nnz && j < y_p->nnz)
+    {
+        a = x_p->idx[i];
+        b = y_p->idx[j];
+        take_x = a <= b;
+        take_y = b <= a;
+        z_p->idx[k] = take_x ? a : b;
+        z_p->val[k] = (take_x ? alpha * x_p->val[i] : 0.0) +
+                      (take_y ? y_p->val[j] : 0.0);
+        i += take_x;
+        j += take_y;
+        k++;
+    }
+    for (; i < x_p->nnz; i++, k++)
+    {
+        z_p->idx[k] = x_p->idx[i];
+        z_p->val[k] = alpha * x_p->val[i];
+    }
+    memcpy(z_p->idx + k, y_p->idx + j, (y_p->nnz - j) * sizeof(int));
+    memcpy(z_p->val + k, y_p->val + j, (y_p->nnz - j) * sizeof(double));
+    k += y_p->nnz - j;
+    z_p->nnz = k;
+} /* Sparse_sparse_axpy */
+
+/* y += alpha*x with x sparse and y dense */
+void Sparse_dense_axpy(
+    double alpha /* in     */,
+    Sparse_vector *x_p /* in     */,
+    double local_y[] /* in/out */)
+{
+    int k;
+
+    for (k = 0; k < x_p->nnz; k++)
+        local_y[x_p->idx[k]] += alpha * x_p->val[k];
+} /* Sparse_dense_axpy */
+
+/* Print the slowest process' time for an operation */
+void Print_time(
+    char title[] /* in */,
+    double elapsed /* in */,
+    int my_rank /* in */,
+    MPI_Comm comm /* in */)
+{
+    double max_elapsed;
+
+    MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    if (my_rank == 0)
+        printf("%s  %10.3f ms\n", title, max_elapsed * 1000);
+} /* Print_time */
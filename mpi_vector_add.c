@@ -14,7 +14,39 @@
  * 1.  The order of the vectors, n, should be evenly divisible
  *     by comm_sz
  * 2.  DEBUG compile flag.
- * 3.  This program does fairly extensive error checking.  When
+ * 3.  HIERARCHICAL compile flag:  distribute and collect the vectors
+ *     in two levels.  Process 0 only talks to one leader per node
+ *     (found with MPI_Comm_split_type), and each leader fans the
+ *     data out to the processes on its node over shared memory.
+ * 4.  DIST_BENCH compile flag:  time the flat MPI_Scatter/MPI_Gather
+ *     against the hierarchical versions and print the results
+ *     together with the number of nodes.
+ * 5.  WIRE_COMPRESSION compile flag:  Read_vector and Print_vector
+ *     compress the blocks with a lossless XOR-delta/byte-shuffle/
+ *     run-length codec when a probe of the compression ratio and
+ *     the link bandwidth shows that it's faster than sending the
+ *     raw doubles.
+ * 6.  PERF_COUNTERS compile flag:  count cycles, instructions, LLC
+ *     misses, dTLB misses and page faults on every process with
+ *     perf_event_open around reading x, reading y and the sum, and
+ *     print their totals and per-process maxima together with the
+ *     IPC and the bytes moved per LLC miss.  Events the kernel won't
+ *     count (e.g., hardware events in a VM, or when
+ *     /proc/sys/kernel/perf_event_paranoid is above 2) are shown as
+ *     n/a.  Page faults include those taken in the kernel, e.g. when
+ *     MPI copies a message into a fresh buffer, unless the kernel
+ *     refuses, and then the report says they are user space only.
+ * 7.  AUTOTUNE compile flag:  y is distributed in chunks with
+ *     MPI_Iscatterv, and each chunk is added while the next one is in
+ *     flight.  The chunk size and the variant of the sum loop (plain,
+ *     unrolled, or non-temporal stores to local_z) are chosen by
+ *     timing every combination on the first run for this host,
+ *     process count and size of local_n, and the winner is saved in
+ *     mpi_vector_add.tune.<host>.  Later runs load it from there;
+ *     run with --retune to time them again.  A retune only replaces
+ *     the saved choice if the new winner is more than TUNE_MARGIN
+ *     faster than it.  Ignored with HIERARCHICAL.
+ * 8.  This program does fairly extensive error checking.  When
  *     an error is detected, a message is printed and the processes
  *     quit.  Errors detected are incorrect values of the vector
  *     order (negative or not evenly divisible by comm_sz), and
@@ -24,7 +56,82 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <mpi.h>
+#ifdef PERF_COUNTERS
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#if defined(AUTOTUNE) && !defined(HIERARCHICAL)
+#  define TUNED_SUM
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define DIST_BENCH_REPS 10
+
+#define CODEC_CHUNK 4096            /* doubles per codec chunk       */
+#define CODEC_SAMPLE 65536          /* doubles compressed by a probe */
+#define CODEC_PROBE_BYTES (1 << 20) /* ping-pong message size        */
+#define CODEC_PROBE_REPS 10
+
+#define PERF_EVENTS 5
+#define PERF_MAX_PHASES 8
+
+#define TUNE_FILE_PREFIX "mpi_vector_add.tune."
+#define TUNE_REPS 9
+#define TUNE_MARGIN 0.05
+#define TUNE_MAX_TRIALS 16
+#define TUNE_MAX_LINES 256
+
+#ifdef PERF_COUNTERS
+#  define PERF_START(pc_p) Perf_start(pc_p)
+#  define PERF_STOP(pc_p, name, bytes) Perf_stop(pc_p, name, bytes)
+#else
+#  define PERF_START(pc_p)
+#  define PERF_STOP(pc_p, name, bytes)
+#endif
+
+/* Communicators and bookkeeping for the two-level distribution */
+typedef struct {
+   MPI_Comm node_comm;    /* processes on the same node as the caller */
+   MPI_Comm leader_comm;  /* one process per node, MPI_COMM_NULL on
+                             the other processes                       */
+   int      node_sz;      /* number of processes in node_comm          */
+   int      node_count;   /* number of nodes                           */
+   int      in_order;     /* 1 if the nodes hold consecutive ranks     */
+   int*     counts;       /* process 0:  elements sent to each leader  */
+   int*     displs;       /* process 0:  offsets of the leader blocks  */
+   int*     order;        /* process 0:  ranks in leader block order   */
+} Node_comms_t;
+
+/* Loops Sum_variant can use */
+typedef enum {SUM_PLAIN, SUM_UNROLL4, SUM_STREAM, SUM_VARIANTS} Sum_variant_t;
+
+/* What the autotuner chooses */
+typedef struct {
+   int  variant;  /* a Sum_variant_t                          */
+   int  chunk;    /* elements of local_y per MPI_Iscatterv    */
+} Tuning_t;
+
+/* Event counts of the phases of a run on one process */
+typedef struct {
+   int     fd[PERF_EVENTS];    /* -1 if the event can't be counted   */
+   int     user_only[PERF_EVENTS];  /* 1 if the kernel was refused
+                                       for an event that counts it   */
+   int     phase_count;
+   char*   names[PERF_MAX_PHASES];
+   double  bytes[PERF_MAX_PHASES];  /* bytes read and written by the
+                                       process in the phase          */
+   double  secs[PERF_MAX_PHASES];
+   double  counts[PERF_MAX_PHASES][PERF_EVENTS];
+   double  start;
+} Perf_counters_t;
 
 void Check_for_error(int local_ok, char fname[], char message[],
       MPI_Comm comm);
@@ -38,38 +145,162 @@ void Print_vector(double local_b[], int local_n, int n, char title[],
       int my_rank, MPI_Comm comm);
 void Parallel_vector_sum(double local_x[], double local_y[],
       double local_z[], int local_n);
+void Setup_node_comms(Node_comms_t* nc_p, int local_n, int my_rank,
+      MPI_Comm comm);
+void Free_node_comms(Node_comms_t* nc_p);
+void Hier_scatter(double a[], double local_a[], int local_n,
+      Node_comms_t* nc_p, int my_rank, MPI_Comm comm);
+void Hier_gather(double local_b[], double b[], int local_n,
+      Node_comms_t* nc_p, int my_rank, MPI_Comm comm);
+void Read_vector_hier(double local_a[], int local_n, int n,
+      char vec_name[], Node_comms_t* nc_p, int my_rank, MPI_Comm comm);
+void Print_vector_hier(double local_b[], int local_n, int n,
+      char title[], Node_comms_t* nc_p, int my_rank, MPI_Comm comm);
+void Compare_distributions(double local_a[], int local_n, int n,
+      Node_comms_t* nc_p, int my_rank, MPI_Comm comm);
+#ifdef WIRE_COMPRESSION
+int Codec_bound(int count);
+int Compress_block(double a[], int count, unsigned char out[]);
+void Decompress_block(unsigned char in[], int count, double a[]);
+double Link_bandwidth(MPI_Comm comm);
+void Probe_codec(double a[], int count, double* comp_bytes_p,
+      double* codec_secs_p);
+int Compression_pays(double raw_bytes, double comp_bytes,
+      double codec_secs, double link_bw);
+void Scatter_compressed(double a[], double local_a[], int local_n,
+      int my_rank, MPI_Comm comm);
+void Gather_compressed(double local_b[], double b[], int local_n,
+      int my_rank, MPI_Comm comm);
+#endif
+#ifdef PERF_COUNTERS
+void Perf_open(Perf_counters_t* pc_p);
+void Perf_start(Perf_counters_t* pc_p);
+void Perf_stop(Perf_counters_t* pc_p, char name[], double bytes);
+void Perf_report(Perf_counters_t* pc_p, int my_rank, MPI_Comm comm);
+void Perf_close(Perf_counters_t* pc_p);
+#endif
+#ifdef TUNED_SUM
+void Sum_variant(double local_x[], double local_y[], double local_z[],
+      int count, int variant);
+void Pipelined_scatter_sum(double a[], double local_x[],
+      double local_y[], double local_z[], int local_n,
+      Tuning_t* tuning_p, int my_rank, MPI_Comm comm);
+void Read_and_sum(double local_x[], double local_y[], double local_z[],
+      int local_n, int n, Tuning_t* tuning_p, int my_rank,
+      MPI_Comm comm);
+int Read_tuning(char path[], char key[], Tuning_t* tuning_p);
+void Write_tuning(char path[], char key[], Tuning_t* tuning_p);
+double Median(double times[], int count);
+void Autotune(Tuning_t* tuning_p, int have_saved, int local_n, int n,
+      int my_rank, MPI_Comm comm);
+void Load_tuning(Tuning_t* tuning_p, int local_n, int n, int retune,
+      int my_rank, MPI_Comm comm);
+#endif
 
 
 /*-------------------------------------------------------------------*/
-int main(void) {
+int main(int argc, char* argv[]) {
    int n, local_n;
    int comm_sz, my_rank;
    double *local_x, *local_y, *local_z;
    MPI_Comm comm;
    double tstart, tend;
+#  if defined(HIERARCHICAL) || defined(DIST_BENCH)
+   Node_comms_t nc;
+#  endif
+#  ifdef PERF_COUNTERS
+   Perf_counters_t pc;
+   double read_bytes;
+#  endif
+#  ifdef TUNED_SUM
+   Tuning_t tuning;
+   int retune = argc > 1 && strcmp(argv[1], "--retune") == 0;
+#  endif
 
-   MPI_Init(NULL, NULL);
+   MPI_Init(&argc, &argv);
    comm = MPI_COMM_WORLD;
    MPI_Comm_size(comm, &comm_sz);
    MPI_Comm_rank(comm, &my_rank);
 
    //Read_n(&n, &local_n, my_rank, comm_sz, comm);
    n = 10000000;
+   Check_for_error(n % comm_sz == 0, "main",
+         "n should be evenly divisible by comm_sz", comm);
+   local_n = n/comm_sz;
+#  if defined(HIERARCHICAL) || defined(DIST_BENCH)
+   Setup_node_comms(&nc, local_n, my_rank, comm);
+#  endif
+#  ifdef PERF_COUNTERS
+   Perf_open(&pc);
+   /* Every process receives its block, process 0 also fills and
+      sends the whole vector */
+   read_bytes = local_n*sizeof(double);
+   if (my_rank == 0) read_bytes += 2.0*n*sizeof(double);
+#  endif
+#  ifdef TUNED_SUM
+   Load_tuning(&tuning, local_n, n, retune, my_rank, comm);
+#  endif
+#  if defined(WIRE_COMPRESSION) && !defined(HIERARCHICAL)
+   /* Run the ping-pong now, so it isn't timed with the first
+      Read_vector */
+   Link_bandwidth(comm);
+#  endif
    tstart = MPI_Wtime();
    Allocate_vectors(&local_x, &local_y, &local_z, local_n, comm);
 
+#  ifdef HIERARCHICAL
+   PERF_START(&pc);
+   Read_vector_hier(local_x, local_n, n, "x", &nc, my_rank, comm);
+   PERF_STOP(&pc, "Read x", read_bytes);
+   PERF_START(&pc);
+   Read_vector_hier(local_y, local_n, n, "y", &nc, my_rank, comm);
+   PERF_STOP(&pc, "Read y", read_bytes);
+#  elif defined(TUNED_SUM)
+   PERF_START(&pc);
+   Read_vector(local_x, local_n, n, "x", my_rank, comm);
+   PERF_STOP(&pc, "Read x", read_bytes);
+   PERF_START(&pc);
+   Read_and_sum(local_x, local_y, local_z, local_n, n, &tuning, my_rank,
+         comm);
+   PERF_STOP(&pc, "Read y and sum",
+         read_bytes + 3.0*local_n*sizeof(double));
+#  else
+   PERF_START(&pc);
    Read_vector(local_x, local_n, n, "x", my_rank, comm);
+   PERF_STOP(&pc, "Read x", read_bytes);
    //Print_vector(local_x, local_n, n, "x is", my_rank, comm);
+   PERF_START(&pc);
    Read_vector(local_y, local_n, n, "y", my_rank, comm);
+   PERF_STOP(&pc, "Read y", read_bytes);
    //Print_vector(local_y, local_n, n, "y is", my_rank, comm);
+#  endif
 
+#  ifndef TUNED_SUM
+   PERF_START(&pc);
    Parallel_vector_sum(local_x, local_y, local_z, local_n);
+   PERF_STOP(&pc, "Parallel_vector_sum", 3.0*local_n*sizeof(double));
+#  endif
    tend = MPI_Wtime();
 
+#  ifdef HIERARCHICAL
+   //Print_vector_hier(local_z, local_n, n, "The sum is", &nc, my_rank,
+   //      comm);
+#  else
    //Print_vector(local_z, local_n, n, "The sum is", my_rank, comm);
+#  endif
    if(my_rank==0)
     printf("\nTook %f ms to run\n", (tend-tstart)*1000);
+#  ifdef PERF_COUNTERS
+   Perf_report(&pc, my_rank, comm);
+   Perf_close(&pc);
+#  endif
 
+#  ifdef DIST_BENCH
+   Compare_distributions(local_z, local_n, n, &nc, my_rank, comm);
+#  endif
+#  if defined(HIERARCHICAL) || defined(DIST_BENCH)
+   Free_node_comms(&nc);
+#  endif
    free(local_x);
    free(local_y);
    free(local_z);
@@ -221,14 +452,22 @@ void Read_vector(
       //fill vec with indez
       for (i = 0; i < n; i++)
          a[i] = i;
+#     ifdef WIRE_COMPRESSION
+      Scatter_compressed(a, local_a, local_n, my_rank, comm);
+#     else
       MPI_Scatter(a, local_n, MPI_DOUBLE, local_a, local_n, MPI_DOUBLE, 0,
          comm);
+#     endif
       free(a);
    } else {
       Check_for_error(local_ok, fname, "Can't allocate temporary vector",
             comm);
+#     ifdef WIRE_COMPRESSION
+      Scatter_compressed(a, local_a, local_n, my_rank, comm);
+#     else
       MPI_Scatter(a, local_n, MPI_DOUBLE, local_a, local_n, MPI_DOUBLE, 0,
          comm);
+#     endif
    }
 }  /* Read_vector */
 
@@ -268,8 +507,12 @@ void Print_vector(
       if (b == NULL) local_ok = 0;
       Check_for_error(local_ok, fname, "Can't allocate temporary vector",
             comm);
+#     ifdef WIRE_COMPRESSION
+      Gather_compressed(local_b, b, local_n, my_rank, comm);
+#     else
       MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE,
             0, comm);
+#     endif
       printf("%s\n", title);
       for (i = 0; i < n; i++)
          printf("%f ", b[i]);
@@ -278,8 +521,12 @@ void Print_vector(
    } else {
       Check_for_error(local_ok, fname, "Can't allocate temporary vector",
             comm);
+#     ifdef WIRE_COMPRESSION
+      Gather_compressed(local_b, b, local_n, my_rank, comm);
+#     else
       MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE, 0,
          comm);
+#     endif
    }
 }  /* Print_vector */
 
@@ -303,3 +550,1435 @@ void Parallel_vector_sum(
    for (local_i = 0; local_i < local_n; local_i++)
       local_z[local_i] = local_x[local_i] + local_y[local_i];
 }  /* Parallel_vector_sum */
+
+
+
+/*-------------------------------------------------------------------
+ * Function:  Setup_node_comms
+ * Purpose:   Build the communicators used by the two-level scatter
+ *            and gather:  one communicator per shared memory node,
+ *            and one communicator containing the node leaders (the
+ *            lowest ranked process on each node).  Process 0 also
+ *            records how many elements each leader handles and the
+ *            order of the ranks in the leader blocks.
+ * In args:   local_n:  size of the local vectors
+ *            my_rank:  calling process' rank in comm
+ *            comm:     communicator containing the calling processes
+ * Out arg:   nc_p:     the node communicators and bookkeeping
+ *
+ * Errors:    if process 0 can't allocate the bookkeeping arrays the
+ *            program terminates
+ *
+ * Note:
+ *    Process 0 is always the leader of its node and rank 0 in
+ *    leader_comm, since the splits are keyed on the rank in comm.
+ */
+void Setup_node_comms(
+      Node_comms_t*  nc_p     /* out */,
+      int            local_n  /* in  */,
+      int            my_rank  /* in  */,
+      MPI_Comm       comm     /* in  */) {
+   int node_rank, i, comm_sz;
+   int* members = NULL;
+   int* sizes = NULL;
+   int* member_displs = NULL;
+   int local_ok = 1;
+   char* fname = "Setup_node_comms";
+
+   MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, my_rank,
+         MPI_INFO_NULL, &nc_p->node_comm);
+   MPI_Comm_size(nc_p->node_comm, &nc_p->node_sz);
+   MPI_Comm_rank(nc_p->node_comm, &node_rank);
+   MPI_Comm_split(comm, node_rank == 0 ? 0 : MPI_UNDEFINED, my_rank,
+         &nc_p->leader_comm);
+
+   nc_p->counts = nc_p->displs = nc_p->order = NULL;
+   nc_p->node_count = 0;
+   nc_p->in_order = 1;
+   if (node_rank == 0) {
+      members = malloc(nc_p->node_sz*sizeof(int));
+      MPI_Comm_size(nc_p->leader_comm, &nc_p->node_count);
+      if (members == NULL) local_ok = 0;
+   }
+   MPI_Comm_size(comm, &comm_sz);
+   if (my_rank == 0) {
+      sizes = malloc(nc_p->node_count*sizeof(int));
+      member_displs = malloc(nc_p->node_count*sizeof(int));
+      nc_p->counts = malloc(nc_p->node_count*sizeof(int));
+      nc_p->displs = malloc(nc_p->node_count*sizeof(int));
+      nc_p->order = malloc(comm_sz*sizeof(int));
+      if (sizes == NULL || member_displs == NULL ||
+          nc_p->counts == NULL || nc_p->displs == NULL ||
+          nc_p->order == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate node bookkeeping",
+         comm);
+
+   MPI_Gather(&my_rank, 1, MPI_INT, members, 1, MPI_INT, 0,
+         nc_p->node_comm);
+   if (node_rank == 0) {
+      MPI_Gather(&nc_p->node_sz, 1, MPI_INT, sizes, 1, MPI_INT, 0,
+            nc_p->leader_comm);
+      if (my_rank == 0) {
+         member_displs[0] = 0;
+         for (i = 1; i < nc_p->node_count; i++)
+            member_displs[i] = member_displs[i-1] + sizes[i-1];
+      }
+      MPI_Gatherv(members, nc_p->node_sz, MPI_INT, nc_p->order, sizes,
+            member_displs, MPI_INT, 0, nc_p->leader_comm);
+   }
+
+   if (my_rank == 0) {
+      for (i = 0; i < nc_p->node_count; i++) {
+         nc_p->counts[i] = sizes[i]*local_n;
+         nc_p->displs[i] = member_displs[i]*local_n;
+      }
+      for (i = 0; i < comm_sz; i++)
+         if (nc_p->order[i] != i) nc_p->in_order = 0;
+   }
+   MPI_Bcast(&nc_p->node_count, 1, MPI_INT, 0, comm);
+
+   free(members);
+   free(sizes);
+   free(member_displs);
+}  /* Setup_node_comms */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Free_node_comms
+ * Purpose:   Release the communicators and storage allocated by
+ *            Setup_node_comms
+ * In/out arg:  nc_p:  the node communicators and bookkeeping
+ */
+void Free_node_comms(
+      Node_comms_t*  nc_p  /* in/out */) {
+   if (nc_p->leader_comm != MPI_COMM_NULL)
+      MPI_Comm_free(&nc_p->leader_comm);
+   MPI_Comm_free(&nc_p->node_comm);
+   free(nc_p->counts);
+   free(nc_p->displs);
+   free(nc_p->order);
+}  /* Free_node_comms */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Hier_scatter
+ * Purpose:   Block distribute a vector stored on process 0 in two
+ *            levels:  process 0 scatters one block per node to the
+ *            node leaders, and each leader scatters its block to the
+ *            processes on its node.
+ * In args:   a:        the full vector (significant on process 0)
+ *            local_n:  size of local vectors
+ *            nc_p:     node communicators from Setup_node_comms
+ *            my_rank:  calling process' rank in comm
+ *            comm:     communicator containing calling processes
+ * Out arg:   local_a:  the calling process' block of a
+ *
+ * Errors:    if process 0 or a leader can't allocate temporary
+ *            storage the program terminates
+ *
+ * Note:
+ *    If the ranks on a node aren't consecutive, process 0 first
+ *    packs the blocks in leader order.
+ */
+void Hier_scatter(
+      double         a[]        /* in  */,
+      double         local_a[]  /* out */,
+      int            local_n    /* in  */,
+      Node_comms_t*  nc_p       /* in  */,
+      int            my_rank    /* in  */,
+      MPI_Comm       comm       /* in  */) {
+   double* packed = a;
+   double* node_buf = NULL;
+   int i, comm_sz;
+   int local_ok = 1;
+   char* fname = "Hier_scatter";
+
+   if (my_rank == 0 && !nc_p->in_order) {
+      MPI_Comm_size(comm, &comm_sz);
+      packed = malloc(comm_sz*local_n*sizeof(double));
+      if (packed == NULL) local_ok = 0;
+      else
+         for (i = 0; i < comm_sz; i++)
+            memcpy(packed + i*local_n, a + nc_p->order[i]*local_n,
+                  local_n*sizeof(double));
+   }
+   if (my_rank != 0 && nc_p->leader_comm != MPI_COMM_NULL) {
+      node_buf = malloc(nc_p->node_sz*local_n*sizeof(double));
+      if (node_buf == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+         comm);
+
+   /* Process 0's node block is the start of packed */
+   if (my_rank == 0) {
+      MPI_Scatterv(packed, nc_p->counts, nc_p->displs, MPI_DOUBLE,
+            MPI_IN_PLACE, 0, MPI_DOUBLE, 0, nc_p->leader_comm);
+      MPI_Scatter(packed, local_n, MPI_DOUBLE, local_a, local_n,
+            MPI_DOUBLE, 0, nc_p->node_comm);
+   } else {
+      if (nc_p->leader_comm != MPI_COMM_NULL)
+         MPI_Scatterv(NULL, NULL, NULL, MPI_DOUBLE, node_buf,
+               nc_p->node_sz*local_n, MPI_DOUBLE, 0, nc_p->leader_comm);
+      MPI_Scatter(node_buf, local_n, MPI_DOUBLE, local_a, local_n,
+            MPI_DOUBLE, 0, nc_p->node_comm);
+   }
+
+   if (packed != a) free(packed);
+   free(node_buf);
+}  /* Hier_scatter */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Hier_gather
+ * Purpose:   Collect a block distributed vector onto process 0 in two
+ *            levels:  each leader gathers the blocks of its node, and
+ *            process 0 gathers one block per node from the leaders.
+ * In args:   local_b:  the calling process' block of the vector
+ *            local_n:  size of local vectors
+ *            nc_p:     node communicators from Setup_node_comms
+ *            my_rank:  calling process' rank in comm
+ *            comm:     communicator containing calling processes
+ * Out arg:   b:        the full vector (significant on process 0)
+ *
+ * Errors:    if process 0 or a leader can't allocate temporary
+ *            storage the program terminates
+ */
+void Hier_gather(
+      double         local_b[]  /* in  */,
+      double         b[]        /* out */,
+      int            local_n    /* in  */,
+      Node_comms_t*  nc_p       /* in  */,
+      int            my_rank    /* in  */,
+      MPI_Comm       comm       /* in  */) {
+   double* packed = b;
+   double* node_buf = NULL;
+   int i, comm_sz = 0;
+   int local_ok = 1;
+   char* fname = "Hier_gather";
+
+   if (my_rank == 0 && !nc_p->in_order) {
+      MPI_Comm_size(comm, &comm_sz);
+      packed = malloc(comm_sz*local_n*sizeof(double));
+      if (packed == NULL) local_ok = 0;
+   }
+   if (my_rank != 0 && nc_p->leader_comm != MPI_COMM_NULL) {
+      node_buf = malloc(nc_p->node_sz*local_n*sizeof(double));
+      if (node_buf == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+         comm);
+
+   /* Process 0's node block is the start of packed */
+   if (my_rank == 0) {
+      MPI_Gather(local_b, local_n, MPI_DOUBLE, packed, local_n,
+            MPI_DOUBLE, 0, nc_p->node_comm);
+      MPI_Gatherv(MPI_IN_PLACE, 0, MPI_DOUBLE, packed, nc_p->counts,
+            nc_p->displs, MPI_DOUBLE, 0, nc_p->leader_comm);
+   } else {
+      MPI_Gather(local_b, local_n, MPI_DOUBLE, node_buf, local_n,
+            MPI_DOUBLE, 0, nc_p->node_comm);
+      if (nc_p->leader_comm != MPI_COMM_NULL)
+         MPI_Gatherv(node_buf, nc_p->node_sz*local_n, MPI_DOUBLE, NULL,
+               NULL, NULL, MPI_DOUBLE, 0, nc_p->leader_comm);
+   }
+
+   if (packed != b) {
+      for (i = 0; i < comm_sz; i++)
+         memcpy(b + nc_p->order[i]*local_n, packed + i*local_n,
+               local_n*sizeof(double));
+      free(packed);
+   }
+   free(node_buf);
+}  /* Hier_gather */
+
+
+/*-------------------------------------------------------------------
+ * Function:   Read_vector_hier
+ * Purpose:    Same as Read_vector, but distribute the vector with
+ *             Hier_scatter
+ * In args:    local_n:  size of local vectors
+ *             n:        size of global vector
+ *             vec_name: name of vector being read (e.g., "x")
+ *             nc_p:     node communicators from Setup_node_comms
+ *             my_rank:  calling process' rank in comm
+ *             comm:     communicator containing calling processes
+ * Out arg:    local_a:  local vector read
+ *
+ * Errors:     if the malloc on process 0 for temporary storage
+ *             fails the program terminates
+ */
+void Read_vector_hier(
+      double         local_a[]   /* out */,
+      int            local_n     /* in  */,
+      int            n           /* in  */,
+      char           vec_name[]  /* in  */,
+      Node_comms_t*  nc_p        /* in  */,
+      int            my_rank     /* in  */,
+      MPI_Comm       comm        /* in  */) {
+   double* a = NULL;
+   int i;
+   int local_ok = 1;
+   char* fname = "Read_vector_hier";
+
+   if (my_rank == 0) {
+      a = malloc(n*sizeof(double));
+      if (a == NULL) local_ok = 0;
+      else
+         for (i = 0; i < n; i++)
+            a[i] = i;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+         comm);
+   Hier_scatter(a, local_a, local_n, nc_p, my_rank, comm);
+   free(a);
+}  /* Read_vector_hier */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Print_vector_hier
+ * Purpose:   Same as Print_vector, but collect the vector with
+ *            Hier_gather
+ * In args:   local_b:  local storage for vector to be printed
+ *            local_n:  order of local vectors
+ *            n:        order of global vector (local_n*comm_sz)
+ *            title:    title to precede print out
+ *            nc_p:     node communicators from Setup_node_comms
+ *            my_rank:  calling process' rank in comm
+ *            comm:     communicator containing processes calling
+ *                      Print_vector_hier
+ *
+ * Error:     if process 0 can't allocate temporary storage for
+ *            the full vector, the program terminates.
+ */
+void Print_vector_hier(
+      double         local_b[]  /* in */,
+      int            local_n    /* in */,
+      int            n          /* in */,
+      char           title[]    /* in */,
+      Node_comms_t*  nc_p       /* in */,
+      int            my_rank    /* in */,
+      MPI_Comm       comm       /* in */) {
+   double* b = NULL;
+   int i;
+   int local_ok = 1;
+   char* fname = "Print_vector_hier";
+
+   if (my_rank == 0) {
+      b = malloc(n*sizeof(double));
+      if (b == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+         comm);
+   Hier_gather(local_b, b, local_n, nc_p, my_rank, comm);
+   if (my_rank == 0) {
+      printf("%s\n", title);
+      for (i = 0; i < n; i++)
+         printf("%f ", b[i]);
+      printf("\n");
+      free(b);
+   }
+}  /* Print_vector_hier */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Compare_distributions
+ * Purpose:   Time the flat MPI_Scatter/MPI_Gather against
+ *            Hier_scatter/Hier_gather, and print the average time of
+ *            each on process 0 along with the number of nodes.
+ * In args:   local_n:  size of local vectors
+ *            n:        size of global vector
+ *            nc_p:     node communicators from Setup_node_comms
+ *            my_rank:  calling process' rank in comm
+ *            comm:     communicator containing calling processes
+ * In/out arg:  local_a:  scratch storage for a local vector
+ *
+ * Errors:    if process 0 can't allocate the full vector the program
+ *            terminates
+ *
+ * Note:
+ *    Run with different host files to compare different node
+ *    counts.
+ */
+void Compare_distributions(
+      double         local_a[]  /* in/out */,
+      int            local_n    /* in     */,
+      int            n          /* in     */,
+      Node_comms_t*  nc_p       /* in     */,
+      int            my_rank    /* in     */,
+      MPI_Comm       comm       /* in     */) {
+   double* a = NULL;
+   double start, elapsed[4], max_elapsed[4];
+   int i, rep, comm_sz;
+   int local_ok = 1;
+   char* fname = "Compare_distributions";
+
+   if (my_rank == 0) {
+      a = malloc(n*sizeof(double));
+      if (a == NULL) local_ok = 0;
+      else
+         for (i = 0; i < n; i++)
+            a[i] = i;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+         comm);
+
+   for (i = 0; i < 4; i++) elapsed[i] = 0.0;
+   for (rep = 0; rep < DIST_BENCH_REPS; rep++) {
+      MPI_Barrier(comm);
+      start = MPI_Wtime();
+      MPI_Scatter(a, local_n, MPI_DOUBLE, local_a, local_n, MPI_DOUBLE,
+            0, comm);
+      elapsed[0] += MPI_Wtime() - start;
+
+      MPI_Barrier(comm);
+      start = MPI_Wtime();
+      MPI_Gather(local_a, local_n, MPI_DOUBLE, a, local_n, MPI_DOUBLE,
+            0, comm);
+      elapsed[1] += MPI_Wtime() - start;
+
+      MPI_Barrier(comm);
+      start = MPI_Wtime();
+      Hier_scatter(a, local_a, local_n, nc_p, my_rank, comm);
+      elapsed[2] += MPI_Wtime() - start;
+
+      MPI_Barrier(comm);
+      start = MPI_Wtime();
+      Hier_gather(local_a, a, local_n, nc_p, my_rank, comm);
+      elapsed[3] += MPI_Wtime() - start;
+   }
+   MPI_Reduce(elapsed, max_elapsed, 4, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   if (my_rank == 0) {
+      MPI_Comm_size(comm, &comm_sz);
+      printf("\nDistribution of n = %d on %d procs, %d node(s):\n", n,
+            comm_sz, nc_p->node_count);
+      printf("   flat scatter   %10.3f ms\n",
+            max_elapsed[0]*1000/DIST_BENCH_REPS);
+      printf("   flat gather    %10.3f ms\n",
+            max_elapsed[1]*1000/DIST_BENCH_REPS);
+      printf("   hier scatter   %10.3f ms\n",
+            max_elapsed[2]*1000/DIST_BENCH_REPS);
+      printf("   hier gather    %10.3f ms\n",
+            max_elapsed[3]*1000/DIST_BENCH_REPS);
+      free(a);
+   }
+}  /* Compare_distributions */
+
+
+#ifdef WIRE_COMPRESSION
+/*-------------------------------------------------------------------
+ * Function:  Codec_bound
+ * Purpose:   Return an upper bound on the number of bytes
+ *            Compress_block can produce for count doubles
+ */
+int Codec_bound(int count /* in */) {
+   int bytes = count*sizeof(double);
+
+   return bytes + bytes/128 + count/CODEC_CHUNK + 1;
+}  /* Codec_bound */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Compress_block
+ * Purpose:   Losslessly compress a block of doubles.  Each chunk of
+ *            CODEC_CHUNK values is XORed with the previous value,
+ *            the bytes are shuffled so that byte k of every value is
+ *            stored together, and the shuffled bytes are run-length
+ *            encoded.
+ * In args:   a:      the values to compress
+ *            count:  the number of values
+ * Out arg:   out:    the compressed bytes, at least Codec_bound(count)
+ *                    bytes long
+ * Ret val:   The number of compressed bytes
+ *
+ * Note:
+ *    A token byte t < 128 is followed by t+1 literal bytes, and a
+ *    token byte t >= 128 is followed by one byte that is repeated
+ *    t-127 times.
+ */
+int Compress_block(
+      double         a[]    /* in  */,
+      int            count  /* in  */,
+      unsigned char  out[]  /* out */) {
+   unsigned char shuffled[CODEC_CHUNK*sizeof(double)];
+   uint64_t prev, cur;
+   int start, chunk, i, k, bytes, run, lit;
+   int out_sz = 0;
+
+   for (start = 0; start < count; start += CODEC_CHUNK) {
+      chunk = count - start < CODEC_CHUNK ? count - start : CODEC_CHUNK;
+      prev = 0;
+      for (i = 0; i < chunk; i++) {
+         memcpy(&cur, &a[start+i], sizeof(cur));
+         for (k = 0; k < sizeof(double); k++)
+            shuffled[k*chunk + i] = (unsigned char) ((cur ^ prev) >> 8*k);
+         prev = cur;
+      }
+
+      bytes = chunk*sizeof(double);
+      i = lit = 0;
+      while (i < bytes) {
+         for (run = 1; i + run < bytes && run < 128 &&
+               shuffled[i+run] == shuffled[i]; run++);
+         if (run >= 3) {
+            if (lit > 0) {
+               out[out_sz++] = lit - 1;
+               memcpy(out + out_sz, shuffled + i - lit, lit);
+               out_sz += lit;
+               lit = 0;
+            }
+            out[out_sz++] = 127 + run;
+            out[out_sz++] = shuffled[i];
+            i += run;
+         } else {
+            lit++;
+            i++;
+            if (lit == 128 || i == bytes) {
+               out[out_sz++] = lit - 1;
+               memcpy(out + out_sz, shuffled + i - lit, lit);
+               out_sz += lit;
+               lit = 0;
+            }
+         }
+      }
+   }
+
+   return out_sz;
+}  /* Compress_block */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Decompress_block
+ * Purpose:   Undo Compress_block
+ * In args:   in:     the compressed bytes
+ *            count:  the number of values that were compressed
+ * Out arg:   a:      the decompressed values
+ */
+void Decompress_block(
+      unsigned char  in[]   /* in  */,
+      int            count  /* in  */,
+      double         a[]    /* out */) {
+   unsigned char shuffled[CODEC_CHUNK*sizeof(double)];
+   uint64_t prev, cur;
+   int start, chunk, i, k, bytes, len;
+   int in_pos = 0;
+
+   for (start = 0; start < count; start += CODEC_CHUNK) {
+      chunk = count - start < CODEC_CHUNK ? count - start : CODEC_CHUNK;
+      bytes = chunk*sizeof(double);
+      i = 0;
+      while (i < bytes) {
+         if (in[in_pos] < 128) {
+            len = in[in_pos++] + 1;
+            memcpy(shuffled + i, in + in_pos, len);
+            in_pos += len;
+         } else {
+            len = in[in_pos++] - 127;
+            memset(shuffled + i, in[in_pos++], len);
+         }
+         i += len;
+      }
+
+      prev = 0;
+      for (i = 0; i < chunk; i++) {
+         cur = 0;
+         for (k = 0; k < sizeof(double); k++)
+            cur |= (uint64_t) shuffled[k*chunk + i] << 8*k;
+         cur ^= prev;
+         memcpy(&a[start+i], &cur, sizeof(cur));
+         prev = cur;
+      }
+   }
+}  /* Decompress_block */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Link_bandwidth
+ * Purpose:   Estimate the bandwidth in bytes/second between process 0
+ *            and the highest ranked process with a ping-pong.  The
+ *            first call measures it, later calls return the saved
+ *            value.  main makes the first call before it starts the
+ *            timers.
+ * In arg:    comm:  communicator containing the calling processes
+ * Ret val:   The estimated bandwidth on every process.  If there's
+ *            only one process, the bandwidth is reported as infinite.
+ */
+double Link_bandwidth(MPI_Comm comm /* in */) {
+   static double bw = 0.0;
+   unsigned char* buf;
+   double start, elapsed;
+   int my_rank, comm_sz, rep;
+   int local_ok = 1;
+   char* fname = "Link_bandwidth";
+
+   if (bw > 0.0) return bw;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+   if (comm_sz == 1) return bw = HUGE_VAL;
+
+   buf = malloc(CODEC_PROBE_BYTES);
+   if (buf == NULL) local_ok = 0;
+   Check_for_error(local_ok, fname, "Can't allocate probe buffer", comm);
+   memset(buf, 0, CODEC_PROBE_BYTES);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   for (rep = 0; rep < CODEC_PROBE_REPS; rep++) {
+      if (my_rank == 0) {
+         MPI_Send(buf, CODEC_PROBE_BYTES, MPI_UNSIGNED_CHAR, comm_sz-1, 0,
+               comm);
+         MPI_Recv(buf, CODEC_PROBE_BYTES, MPI_UNSIGNED_CHAR, comm_sz-1, 0,
+               comm, MPI_STATUS_IGNORE);
+      } else if (my_rank == comm_sz-1) {
+         MPI_Recv(buf, CODEC_PROBE_BYTES, MPI_UNSIGNED_CHAR, 0, 0, comm,
+               MPI_STATUS_IGNORE);
+         MPI_Send(buf, CODEC_PROBE_BYTES, MPI_UNSIGNED_CHAR, 0, 0, comm);
+      }
+   }
+   elapsed = MPI_Wtime() - start;
+   free(buf);
+
+   if (my_rank == 0)
+      bw = 2.0*CODEC_PROBE_REPS*CODEC_PROBE_BYTES/elapsed;
+   MPI_Bcast(&bw, 1, MPI_DOUBLE, 0, comm);
+   return bw;
+}  /* Link_bandwidth */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Probe_codec
+ * Purpose:   Compress and decompress a sample from the start of a
+ *            block to estimate the compressed size and the codec time
+ *            for the whole block.
+ * In args:   a:      the block
+ *            count:  the number of values in the block
+ * Out args:  comp_bytes_p:  estimated compressed size of the block
+ *            codec_secs_p:  estimated time to compress and decompress
+ *                           the block
+ *
+ * Errors:    If the scratch buffers can't be allocated, the block is
+ *            reported as incompressible
+ */
+void Probe_codec(
+      double   a[]            /* in  */,
+      int      count          /* in  */,
+      double*  comp_bytes_p   /* out */,
+      double*  codec_secs_p   /* out */) {
+   int sample = count < CODEC_SAMPLE ? count : CODEC_SAMPLE;
+   unsigned char* comp = malloc(Codec_bound(sample));
+   double* check = malloc(sample*sizeof(double));
+   double start, scale = (double) count/sample;
+
+   *comp_bytes_p = (double) count*sizeof(double);
+   *codec_secs_p = HUGE_VAL;
+   if (sample > 0 && comp != NULL && check != NULL) {
+      start = MPI_Wtime();
+      *comp_bytes_p = scale*Compress_block(a, sample, comp);
+      Decompress_block(comp, sample, check);
+      *codec_secs_p = scale*(MPI_Wtime() - start);
+   }
+   free(comp);
+   free(check);
+}  /* Probe_codec */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Compression_pays
+ * Purpose:   Decide whether sending compressed data is faster than
+ *            sending the raw data
+ * In args:   raw_bytes:   size of the uncompressed data
+ *            comp_bytes:  estimated size of the compressed data
+ *            codec_secs:  estimated time to compress and decompress
+ *            link_bw:     bandwidth of the link in bytes/second
+ * Ret val:   1 if compression should be used, 0 otherwise
+ */
+int Compression_pays(
+      double  raw_bytes   /* in */,
+      double  comp_bytes  /* in */,
+      double  codec_secs  /* in */,
+      double  link_bw     /* in */) {
+   return comp_bytes/link_bw + codec_secs < raw_bytes/link_bw;
+}  /* Compression_pays */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Scatter_compressed
+ * Purpose:   Block distribute a vector from process 0, compressing
+ *            each block on the wire when the compression ratio and
+ *            the link bandwidth make it faster.
+ * In args:   a:        the full vector (significant on process 0)
+ *            local_n:  size of local vectors
+ *            my_rank:  calling process' rank in comm
+ *            comm:     communicator containing calling processes
+ * Out arg:   local_a:  the calling process' block of a
+ *
+ * Errors:    if the temporary storage can't be allocated the program
+ *            terminates
+ */
+void Scatter_compressed(
+      double    a[]        /* in  */,
+      double    local_a[]  /* out */,
+      int       local_n    /* in  */,
+      int       my_rank    /* in  */,
+      MPI_Comm  comm       /* in  */) {
+   double link_bw = Link_bandwidth(comm);
+   double comp_bytes, codec_secs;
+   unsigned char *comp = NULL, *local_comp;
+   int *sizes = NULL, *displs = NULL;
+   int use_codec = 0, local_sz, comm_sz, q;
+   int local_ok = 1;
+   char* fname = "Scatter_compressed";
+
+   MPI_Comm_size(comm, &comm_sz);
+   if (my_rank == 0) {
+      Probe_codec(a, local_n, &comp_bytes, &codec_secs);
+      use_codec = Compression_pays((double) local_n*sizeof(double),
+            comp_bytes, codec_secs, link_bw);
+   }
+   MPI_Bcast(&use_codec, 1, MPI_INT, 0, comm);
+#  ifdef DEBUG
+   if (my_rank == 0)
+      printf("Proc 0 > In %s, compression %s\n", fname,
+            use_codec ? "on" : "off");
+#  endif
+   if (!use_codec) {
+      MPI_Scatter(a, local_n, MPI_DOUBLE, local_a, local_n, MPI_DOUBLE,
+            0, comm);
+      return;
+   }
+
+   local_comp = malloc(Codec_bound(local_n));
+   if (local_comp == NULL) local_ok = 0;
+   if (my_rank == 0) {
+      comp = malloc((size_t) comm_sz*Codec_bound(local_n));
+      sizes = malloc(comm_sz*sizeof(int));
+      displs = malloc(comm_sz*sizeof(int));
+      if (comp == NULL || sizes == NULL || displs == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate temporary storage",
+         comm);
+
+   if (my_rank == 0)
+      for (q = 0; q < comm_sz; q++) {
+         displs[q] = q == 0 ? 0 : displs[q-1] + sizes[q-1];
+         sizes[q] = Compress_block(a + q*local_n, local_n,
+               comp + displs[q]);
+      }
+   MPI_Scatter(sizes, 1, MPI_INT, &local_sz, 1, MPI_INT, 0, comm);
+   MPI_Scatterv(comp, sizes, displs, MPI_UNSIGNED_CHAR, local_comp,
+         local_sz, MPI_UNSIGNED_CHAR, 0, comm);
+   Decompress_block(local_comp, local_n, local_a);
+
+   free(local_comp);
+   free(comp);
+   free(sizes);
+   free(displs);
+}  /* Scatter_compressed */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Gather_compressed
+ * Purpose:   Collect a block distributed vector onto process 0,
+ *            compressing each block on the wire when the compression
+ *            ratio and the link bandwidth make it faster.
+ * In args:   local_b:  the calling process' block of the vector
+ *            local_n:  size of local vectors
+ *            my_rank:  calling process' rank in comm
+ *            comm:     communicator containing calling processes
+ * Out arg:   b:        the full vector (significant on process 0)
+ *
+ * Errors:    if the temporary storage can't be allocated the program
+ *            terminates
+ *
+ * Note:
+ *    Every process probes its own block, and the estimates are
+ *    summed so that all the processes make the same decision.
+ */
+void Gather_compressed(
+      double    local_b[]  /* in  */,
+      double    b[]        /* out */,
+      int       local_n    /* in  */,
+      int       my_rank    /* in  */,
+      MPI_Comm  comm       /* in  */) {
+   double link_bw = Link_bandwidth(comm);
+   double est[3], total[3];
+   unsigned char *comp = NULL, *local_comp;
+   int *sizes = NULL, *displs = NULL;
+   int use_codec, local_sz, comm_sz, q;
+   int local_ok = 1;
+   char* fname = "Gather_compressed";
+
+   MPI_Comm_size(comm, &comm_sz);
+   est[0] = (double) local_n*sizeof(double);
+   Probe_codec(local_b, local_n, &est[1], &est[2]);
+   MPI_Allreduce(est, total, 3, MPI_DOUBLE, MPI_SUM, comm);
+   use_codec = Compression_pays(total[0], total[1], total[2], link_bw);
+#  ifdef DEBUG
+   if (my_rank == 0)
+      printf("Proc 0 > In %s, compression %s\n", fname,
+            use_codec ? "on" : "off");
+#  endif
+   if (!use_codec) {
+      MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE,
+            0, comm);
+      return;
+   }
+
+   local_comp = malloc(Codec_bound(local_n));
+   if (local_comp == NULL) local_ok = 0;
+   if (my_rank == 0) {
+      comp = malloc((size_t) comm_sz*Codec_bound(local_n));
+      sizes = malloc(comm_sz*sizeof(int));
+      displs = malloc(comm_sz*sizeof(int));
+      if (comp == NULL || sizes == NULL || displs == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate temporary storage",
+         comm);
+
+   local_sz = Compress_block(local_b, local_n, local_comp);
+   MPI_Gather(&local_sz, 1, MPI_INT, sizes, 1, MPI_INT, 0, comm);
+   if (my_rank == 0)
+      for (q = 0; q < comm_sz; q++)
+         displs[q] = q == 0 ? 0 : displs[q-1] + sizes[q-1];
+   MPI_Gatherv(local_comp, local_sz, MPI_UNSIGNED_CHAR, comp, sizes,
+         displs, MPI_UNSIGNED_CHAR, 0, comm);
+   if (my_rank == 0)
+      for (q = 0; q < comm_sz; q++)
+         Decompress_block(comp + displs[q], local_n, b + q*local_n);
+
+   free(local_comp);
+   free(comp);
+   free(sizes);
+   free(displs);
+}  /* Gather_compressed */
+#endif
+
+#ifdef PERF_COUNTERS
+/*-------------------------------------------------------------------
+ * Function:  Perf_open
+ * Purpose:   Open a disabled counter for each event on the calling
+ *            process.  The hardware events only count user space, so
+ *            they work with perf_event_paranoid = 2.  Page faults also
+ *            count the kernel, where MPI's copies into fresh buffers
+ *            fault, if the kernel allows it.
+ * Out arg:   pc_p:  the counters, with no phases yet
+ *
+ * Note:
+ *    An event that can't be opened gets fd = -1 and is reported as
+ *    n/a, it doesn't stop the program.
+ */
+void Perf_open(Perf_counters_t* pc_p /* out */) {
+   static const struct {
+      unsigned type;
+      unsigned long long config;
+      int kernel;  /* 1 to count the kernel too, if allowed */
+   } events[PERF_EVENTS] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 0},
+      {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+            PERF_COUNT_HW_CACHE_OP_READ << 8 |
+            PERF_COUNT_HW_CACHE_RESULT_MISS << 16, 0},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, 1}
+   };
+   struct perf_event_attr attr;
+   int e;
+
+   for (e = 0; e < PERF_EVENTS; e++) {
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = events[e].type;
+      attr.config = events[e].config;
+      attr.disabled = 1;
+      attr.exclude_kernel = !events[e].kernel;
+      attr.exclude_hv = 1;
+      /* Scale the counts if the kernel multiplexes the events */
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING;
+      pc_p->fd[e] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+      if (pc_p->fd[e] < 0 && !attr.exclude_kernel) {
+         attr.exclude_kernel = 1;
+         pc_p->fd[e] = syscall(__NR_perf_event_open, &attr, 0, -1, -1,
+               0);
+      }
+      pc_p->user_only[e] = events[e].kernel && attr.exclude_kernel;
+   }
+   pc_p->phase_count = 0;
+}  /* Perf_open */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Perf_start
+ * Purpose:   Zero and enable the counters at the start of a phase
+ * In/out arg:  pc_p:  the counters
+ */
+void Perf_start(Perf_counters_t* pc_p /* in/out */) {
+   int e;
+
+   for (e = 0; e < PERF_EVENTS; e++)
+      if (pc_p->fd[e] >= 0) {
+         ioctl(pc_p->fd[e], PERF_EVENT_IOC_RESET, 0);
+         ioctl(pc_p->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+      }
+   pc_p->start = MPI_Wtime();
+}  /* Perf_start */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Perf_stop
+ * Purpose:   Disable the counters at the end of a phase and save the
+ *            counts and the elapsed time as a new phase.
+ * In args:   name:   the phase's name in the report
+ *            bytes:  bytes the calling process reads and writes in
+ *                    the phase, for the bytes per LLC miss
+ * In/out arg:  pc_p:  the counters
+ */
+void Perf_stop(
+      Perf_counters_t*  pc_p   /* in/out */,
+      char              name[] /* in     */,
+      double            bytes  /* in     */) {
+   unsigned long long value[3];  /* count, time enabled, time running */
+   double secs = MPI_Wtime() - pc_p->start;
+   int e, p = pc_p->phase_count;
+
+   if (p == PERF_MAX_PHASES) return;
+   for (e = 0; e < PERF_EVENTS; e++) {
+      pc_p->counts[p][e] = 0.0;
+      if (pc_p->fd[e] < 0) continue;
+      ioctl(pc_p->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+      if (read(pc_p->fd[e], value, sizeof(value)) == sizeof(value)
+            && value[2] > 0)
+         pc_p->counts[p][e] = (double) value[0]*value[1]/value[2];
+   }
+   pc_p->names[p] = name;
+   pc_p->bytes[p] = bytes;
+   pc_p->secs[p] = secs;
+   pc_p->phase_count++;
+}  /* Perf_stop */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Perf_report
+ * Purpose:   Sum the counts of each phase over the processes and
+ *            print them on process 0 with the largest count on a
+ *            single process, the IPC and the bytes per LLC miss.
+ * In args:   pc_p:     the counters
+ *            my_rank:  calling process' rank in comm
+ *            comm:     communicator containing the calling processes
+ *
+ * Note:
+ *    An event is shown as n/a unless every process could count it,
+ *    and as user space only if some process couldn't count the
+ *    kernel.
+ */
+void Perf_report(
+      Perf_counters_t*  pc_p     /* in */,
+      int               my_rank  /* in */,
+      MPI_Comm          comm     /* in */) {
+   static char* event_names[PERF_EVENTS] = {"cycles", "instructions",
+      "LLC misses", "dTLB misses", "page faults"};
+   int local_ok[PERF_EVENTS], ok[PERF_EVENTS], user_only[PERF_EVENTS];
+   /* counts, then the time and the bytes of the phase */
+   double local[PERF_EVENTS + 2], sum[PERF_EVENTS + 2],
+          max[PERF_EVENTS + 2];
+   int comm_sz, p, e;
+
+   MPI_Comm_size(comm, &comm_sz);
+   for (e = 0; e < PERF_EVENTS; e++)
+      local_ok[e] = pc_p->fd[e] >= 0;
+   MPI_Allreduce(local_ok, ok, PERF_EVENTS, MPI_INT, MPI_MIN, comm);
+   MPI_Reduce(pc_p->user_only, user_only, PERF_EVENTS, MPI_INT, MPI_MAX,
+         0, comm);
+
+   if (my_rank == 0) {
+      printf("\nCounters, total over %d processes (largest process):\n",
+            comm_sz);
+      for (e = 0; e < PERF_EVENTS; e++)
+         if (ok[e] && user_only[e])
+            printf("Note:  %s taken in the kernel are excluded\n",
+                  event_names[e]);
+   }
+   for (p = 0; p < pc_p->phase_count; p++) {
+      memcpy(local, pc_p->counts[p], PERF_EVENTS*sizeof(double));
+      local[PERF_EVENTS] = pc_p->secs[p];
+      local[PERF_EVENTS + 1] = pc_p->bytes[p];
+      MPI_Reduce(local, sum, PERF_EVENTS + 2, MPI_DOUBLE, MPI_SUM, 0,
+            comm);
+      MPI_Reduce(local, max, PERF_EVENTS + 2, MPI_DOUBLE, MPI_MAX, 0,
+            comm);
+      if (my_rank != 0) continue;
+
+      printf("%s:  %.3f ms\n", pc_p->names[p], max[PERF_EVENTS]*1000);
+      for (e = 0; e < PERF_EVENTS; e++)
+         if (ok[e])
+            printf("   %-13s %14.0f  (%.0f)\n", event_names[e], sum[e],
+                  max[e]);
+         else
+            printf("   %-13s %14s\n", event_names[e], "n/a");
+      printf("   IPC ");
+      if (ok[0] && ok[1] && sum[0] > 0)
+         printf("%.2f", sum[1]/sum[0]);
+      else
+         printf("n/a");
+      printf(", bytes per LLC miss ");
+      if (ok[2] && sum[2] > 0)
+         printf("%.1f\n", sum[PERF_EVENTS + 1]/sum[2]);
+      else
+         printf("n/a\n");
+   }
+}  /* Perf_report */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Perf_close
+ * Purpose:   Close the counters
+ * In/out arg:  pc_p:  the counters
+ */
+void Perf_close(Perf_counters_t* pc_p /* in/out */) {
+   int e;
+
+   for (e = 0; e < PERF_EVENTS; e++)
+      if (pc_p->fd[e] >= 0) close(pc_p->fd[e]);
+}  /* Perf_close */
+#endif
+
+#ifdef TUNED_SUM
+/*-------------------------------------------------------------------
+ * Function:  Sum_variant
+ * Purpose:   local_z = local_x + local_y with one of the loops the
+ *            autotuner chooses from
+ * In args:   local_x, local_y:  the vectors being added
+ *            count:             number of elements
+ *            variant:           SUM_PLAIN, SUM_UNROLL4 or SUM_STREAM
+ * Out arg:   local_z:           the sum
+ *
+ * Note:
+ *    SUM_STREAM writes local_z with non-temporal stores, which skip
+ *    the cache:  that saves reading local_z's lines before writing
+ *    them, but the sum won't be in cache afterwards.  Without SSE2
+ *    it's the same as SUM_PLAIN.
+ */
+void Sum_variant(
+      double  local_x[]  /* in  */,
+      double  local_y[]  /* in  */,
+      double  local_z[]  /* out */,
+      int     count      /* in  */,
+      int     variant    /* in  */) {
+   int i = 0;
+
+   switch (variant) {
+      case SUM_UNROLL4:
+         for (; i + 4 <= count; i += 4) {
+            local_z[i]   = local_x[i]   + local_y[i];
+            local_z[i+1] = local_x[i+1] + local_y[i+1];
+            local_z[i+2] = local_x[i+2] + local_y[i+2];
+            local_z[i+3] = local_x[i+3] + local_y[i+3];
+         }
+         break;
+#     ifdef __SSE2__
+      case SUM_STREAM:
+         /* _mm_stream_pd needs a 16 byte aligned address */
+         if (((uintptr_t) local_z & 15) != 0 && count > 0) {
+            local_z[0] = local_x[0] + local_y[0];
+            i = 1;
+         }
+         for (; i + 2 <= count; i += 2)
+            _mm_stream_pd(local_z + i, _mm_add_pd(_mm_loadu_pd(local_x + i),
+                  _mm_loadu_pd(local_y + i)));
+         _mm_sfence();
+         break;
+#     endif
+   }
+   for (; i < count; i++)
+      local_z[i] = local_x[i] + local_y[i];
+}  /* Sum_variant */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Pipelined_scatter_sum
+ * Purpose:   Distribute the vector a on process 0 into local_y in
+ *            chunks of tuning_p->chunk elements per process, and add
+ *            each chunk to local_x while the next one is in flight.
+ * In args:   a:         the vector on process 0
+ *            local_x:   local block of the other vector
+ *            local_n:   size of the local blocks
+ *            tuning_p:  chunk size and sum variant
+ *            my_rank:   calling process' rank in comm
+ *            comm:      communicator containing the calling processes
+ * Out args:  local_y:   local block of a
+ *            local_z:   local block of the sum
+ *
+ * Errors:    if process 0 can't allocate the counts and offsets the
+ *            program terminates
+ */
+void Pipelined_scatter_sum(
+      double     a[]        /* in  */,
+      double     local_x[]  /* in  */,
+      double     local_y[]  /* out */,
+      double     local_z[]  /* out */,
+      int        local_n    /* in  */,
+      Tuning_t*  tuning_p   /* in  */,
+      int        my_rank    /* in  */,
+      MPI_Comm   comm       /* in  */) {
+   int* counts = NULL;
+   int* displs = NULL;
+   int chunk = tuning_p->chunk, start, next, count, comm_sz, q;
+   int local_ok = 1;
+   char* fname = "Pipelined_scatter_sum";
+   MPI_Request req;
+
+   MPI_Comm_size(comm, &comm_sz);
+   if (my_rank == 0) {
+      counts = malloc(comm_sz*sizeof(int));
+      displs = malloc(comm_sz*sizeof(int));
+      if (counts == NULL || displs == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate counts", comm);
+   if (chunk <= 0 || chunk > local_n) chunk = local_n;
+
+   /* The counts and offsets of a chunk can't change until its scatter
+      has finished, so the next one is started after the wait */
+   count = chunk;
+   if (my_rank == 0)
+      for (q = 0; q < comm_sz; q++) {
+         counts[q] = count;
+         displs[q] = q*local_n;
+      }
+   MPI_Iscatterv(a, counts, displs, MPI_DOUBLE, local_y, count,
+         MPI_DOUBLE, 0, comm, &req);
+   for (start = 0; start < local_n; start = next) {
+      next = start + count;
+      MPI_Wait(&req, MPI_STATUS_IGNORE);
+      if (next < local_n) {
+         int next_count = local_n - next < chunk ? local_n - next : chunk;
+         if (my_rank == 0)
+            for (q = 0; q < comm_sz; q++) {
+               counts[q] = next_count;
+               displs[q] = q*local_n + next;
+            }
+         MPI_Iscatterv(a, counts, displs, MPI_DOUBLE, local_y + next,
+               next_count, MPI_DOUBLE, 0, comm, &req);
+         Sum_variant(local_x + start, local_y + start, local_z + start,
+               count, tuning_p->variant);
+         count = next_count;
+      } else
+         Sum_variant(local_x + start, local_y + start, local_z + start,
+               count, tuning_p->variant);
+   }
+
+   free(counts);
+   free(displs);
+}  /* Pipelined_scatter_sum */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Read_and_sum
+ * Purpose:   Read_vector for y followed by Parallel_vector_sum, with
+ *            the distribution and the sum overlapped by
+ *            Pipelined_scatter_sum
+ * In args:   local_x:   local block of x
+ *            local_n:   size of the local blocks
+ *            n:         size of the vectors
+ *            tuning_p:  chunk size and sum variant
+ *            my_rank:   calling process' rank in comm
+ *            comm:      communicator containing the calling processes
+ * Out args:  local_y:   local block of y
+ *            local_z:   local block of x + y
+ *
+ * Errors:    if the malloc on process 0 for temporary storage fails
+ *            the program terminates
+ */
+void Read_and_sum(
+      double     local_x[]  /* in  */,
+      double     local_y[]  /* out */,
+      double     local_z[]  /* out */,
+      int        local_n    /* in  */,
+      int        n          /* in  */,
+      Tuning_t*  tuning_p   /* in  */,
+      int        my_rank    /* in  */,
+      MPI_Comm   comm       /* in  */) {
+   double* a = NULL;
+   int i;
+   int local_ok = 1;
+   char* fname = "Read_and_sum";
+
+   if (my_rank == 0) {
+      a = malloc(n*sizeof(double));
+      if (a == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+         comm);
+   if (my_rank == 0)
+      for (i = 0; i < n; i++)
+         a[i] = i;
+   Pipelined_scatter_sum(a, local_x, local_y, local_z, local_n, tuning_p,
+         my_rank, comm);
+   free(a);
+}  /* Read_and_sum */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Read_tuning
+ * Purpose:   Look up the tuning saved for key in the tuning file
+ * In args:   path:      the tuning file
+ *            key:       "<comm_sz> <log2 of local_n>"
+ * Out arg:   tuning_p:  the saved tuning, if there is one
+ * Ret val:   1 if key was found, 0 otherwise
+ *
+ * Note:
+ *    Each line of the file is "<comm_sz> <log2 of local_n> <variant>
+ *    <chunk>".
+ */
+int Read_tuning(
+      char       path[]    /* in  */,
+      char       key[]     /* in  */,
+      Tuning_t*  tuning_p  /* out */) {
+   FILE* fp;
+   char line[128];
+   int found = 0;
+
+   fp = fopen(path, "r");
+   if (fp == NULL) return 0;
+   while (!found && fgets(line, sizeof(line), fp) != NULL)
+      if (strncmp(line, key, strlen(key)) == 0 &&
+            line[strlen(key)] == ' ' &&
+            sscanf(line + strlen(key), "%d %d", &tuning_p->variant,
+               &tuning_p->chunk) == 2 &&
+            tuning_p->variant >= 0 && tuning_p->variant < SUM_VARIANTS)
+         found = 1;
+   fclose(fp);
+   return found;
+}  /* Read_tuning */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Write_tuning
+ * Purpose:   Save the tuning for key in the tuning file, replacing the
+ *            old line for key if there is one
+ * In args:   path:      the tuning file
+ *            key:       "<comm_sz> <log2 of local_n>"
+ *            tuning_p:  the tuning
+ */
+void Write_tuning(
+      char       path[]    /* in */,
+      char       key[]     /* in */,
+      Tuning_t*  tuning_p  /* in */) {
+   FILE* fp;
+   char lines[TUNE_MAX_LINES][128];
+   int line_count = 0, i;
+
+   fp = fopen(path, "r");
+   if (fp != NULL) {
+      while (line_count < TUNE_MAX_LINES - 1 &&
+            fgets(lines[line_count], sizeof(lines[0]), fp) != NULL)
+         if (strncmp(lines[line_count], key, strlen(key)) != 0 ||
+               lines[line_count][strlen(key)] != ' ')
+            line_count++;
+      fclose(fp);
+   }
+   snprintf(lines[line_count++], sizeof(lines[0]), "%s %d %d\n", key,
+         tuning_p->variant, tuning_p->chunk);
+
+   fp = fopen(path, "w");
+   if (fp == NULL) {
+      fprintf(stderr, "Can't write %s\n", path);
+      return;
+   }
+   for (i = 0; i < line_count; i++)
+      fputs(lines[i], fp);
+   fclose(fp);
+}  /* Write_tuning */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Median
+ * Purpose:   Return the median of times, which it sorts
+ * In arg:    count:  number of times
+ * In/out arg:  times:  the times
+ */
+double Median(
+      double  times[]  /* in/out */,
+      int     count    /* in     */) {
+   double t;
+   int i, j;
+
+   for (i = 1; i < count; i++) {
+      t = times[i];
+      for (j = i; j > 0 && times[j-1] > t; j--)
+         times[j] = times[j-1];
+      times[j] = t;
+   }
+   return count % 2 ? times[count/2] :
+         (times[count/2 - 1] + times[count/2])/2;
+}  /* Median */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Autotune
+ * Purpose:   Time Pipelined_scatter_sum with every sum variant and
+ *            chunk size on vectors of the size the run uses, and
+ *            return the fastest combination
+ * In args:   have_saved:  nonzero if *tuning_p holds the saved choice
+ *            local_n:     size of the local blocks
+ *            n:           size of the vectors
+ *            my_rank:     calling process' rank in comm
+ *            comm:        communicator containing the calling
+ *                         processes
+ * In/out arg:  tuning_p:  the saved choice, if have_saved, and then
+ *                         the fastest combination, the same on every
+ *                         process
+ *
+ * Errors:    if the buffers can't be allocated the program terminates
+ *
+ * Note:
+ *    Each combination is timed TUNE_REPS times, in rounds that run
+ *    every combination once, so a change in the load on the machine
+ *    affects all of them alike, and is ranked by its median.  The
+ *    saved choice is kept unless the fastest combination beats it by
+ *    more than TUNE_MARGIN.
+ */
+void Autotune(
+      Tuning_t*  tuning_p    /* in/out */,
+      int        have_saved  /* in     */,
+      int        local_n     /* in     */,
+      int        n           /* in     */,
+      int        my_rank     /* in     */,
+      MPI_Comm   comm        /* in     */) {
+   /* 0 stands for all of local_n in one scatter */
+   static int chunks[] = {0, 1 << 18, 1 << 16, 1 << 14};
+   double *a = NULL, *local_x, *local_y, *local_z;
+   double times[TUNE_MAX_TRIALS][TUNE_REPS], median, best = HUGE_VAL;
+   double saved_median = HUGE_VAL;
+   Tuning_t trials[TUNE_MAX_TRIALS], saved = *tuning_p;
+   int trial_count = 0, t, c, v, rep, i;
+   int local_ok = 1;
+   char* fname = "Autotune";
+
+   for (v = 0; v < SUM_VARIANTS; v++) {
+#     ifndef __SSE2__
+      if (v == SUM_STREAM) continue;
+#     endif
+      for (c = 0; c < sizeof(chunks)/sizeof(chunks[0]); c++)
+         if (chunks[c] < local_n) {
+            trials[trial_count].variant = v;
+            trials[trial_count].chunk = chunks[c];
+            trial_count++;
+         }
+   }
+
+   Allocate_vectors(&local_x, &local_y, &local_z, local_n, comm);
+   if (my_rank == 0) {
+      a = malloc(n*sizeof(double));
+      if (a == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+         comm);
+   if (my_rank == 0)
+      for (i = 0; i < n; i++)
+         a[i] = i;
+   for (i = 0; i < local_n; i++)
+      local_x[i] = local_y[i] = local_z[i] = 0.0;
+
+   for (rep = 0; rep < TUNE_REPS; rep++)
+      for (t = 0; t < trial_count; t++) {
+         MPI_Barrier(comm);
+         times[t][rep] = MPI_Wtime();
+         Pipelined_scatter_sum(a, local_x, local_y, local_z, local_n,
+               &trials[t], my_rank, comm);
+         times[t][rep] = MPI_Wtime() - times[t][rep];
+      }
+   /* Every process gets the same times, so they all pick the same
+      winner.  Only the first trial_count rows have been filled in. */
+   MPI_Allreduce(MPI_IN_PLACE, times, trial_count*TUNE_REPS,
+         MPI_DOUBLE, MPI_MAX, comm);
+
+   for (t = 0; t < trial_count; t++) {
+      median = Median(times[t], TUNE_REPS);
+      if (median < best) {
+         best = median;
+         *tuning_p = trials[t];
+      }
+      if (have_saved && trials[t].variant == saved.variant &&
+            trials[t].chunk == saved.chunk)
+         saved_median = median;
+   }
+   if (best > (1 - TUNE_MARGIN)*saved_median)
+      *tuning_p = saved;
+
+   free(a);
+   free(local_x);
+   free(local_y);
+   free(local_z);
+}  /* Autotune */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Load_tuning
+ * Purpose:   Get the tuning for this host, process count and size of
+ *            local_n from the tuning file, or run Autotune and save
+ *            its result if there's none or retune is set
+ * In args:   local_n:   size of the local blocks
+ *            n:         size of the vectors
+ *            retune:    nonzero to time the combinations again even
+ *                       if the file has a tuning, which Autotune then
+ *                       keeps unless it's clearly beaten
+ *            my_rank:   calling process' rank in comm
+ *            comm:      communicator containing the calling processes
+ * Out arg:   tuning_p:  the tuning, the same on every process
+ *
+ * Note:
+ *    Only process 0 reads and writes the tuning file, which is named
+ *    after its host.
+ */
+void Load_tuning(
+      Tuning_t*  tuning_p  /* out */,
+      int        local_n   /* in  */,
+      int        n         /* in  */,
+      int        retune    /* in  */,
+      int        my_rank   /* in  */,
+      MPI_Comm   comm      /* in  */) {
+   static char* variant_names[SUM_VARIANTS] = {"plain", "unroll4",
+      "stream"};
+   char host[MPI_MAX_PROCESSOR_NAME], path[MPI_MAX_PROCESSOR_NAME + 32];
+   char key[32];
+   int comm_sz, log_n, len, found = 0;
+   double start = MPI_Wtime();
+   Tuning_t saved;
+
+   MPI_Comm_size(comm, &comm_sz);
+   for (log_n = 0; (2L << log_n) <= local_n; log_n++);
+   snprintf(key, sizeof(key), "%d %d", comm_sz, log_n);
+   if (my_rank == 0) {
+      MPI_Get_processor_name(host, &len);
+      snprintf(path, sizeof(path), "%s%s", TUNE_FILE_PREFIX, host);
+      found = Read_tuning(path, key, tuning_p);
+   }
+   MPI_Bcast(&found, 1, MPI_INT, 0, comm);
+   if (found)
+      MPI_Bcast(tuning_p, 2, MPI_INT, 0, comm);
+   saved = *tuning_p;
+
+   if (!found || retune) {
+      Autotune(tuning_p, found, local_n, n, my_rank, comm);
+      if (my_rank == 0) Write_tuning(path, key, tuning_p);
+   }
+
+   if (my_rank == 0) {
+      printf("Sum variant %s, ", variant_names[tuning_p->variant]);
+      if (tuning_p->chunk == 0)
+         printf("no chunks");
+      else
+         printf("chunks of %d elements", tuning_p->chunk);
+      if (found && !retune)
+         printf(" (from %s)\n", path);
+      else if (found && tuning_p->variant == saved.variant &&
+            tuning_p->chunk == saved.chunk)
+         printf(" (tuned in %.1f s, kept the choice in %s)\n",
+               MPI_Wtime() - start, path);
+      else
+         printf(" (tuned in %.1f s, saved in %s)\n", MPI_Wtime() - start,
+               path);
+   }
+}  /* Load_tuning */
+#endif
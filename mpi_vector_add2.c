@@ -1,13 +1,44 @@
 /*
  * Compile:  mpicc mpi-vector-add2.c -o mpi-vector-add2
  * Run:      mpiexec -n N ./mpi-vector-add2
+ *
+ * Add -DWIRE_COMPRESSION to let Print_vector compress the blocks on
+ * the wire when that's faster than sending the raw doubles.  The link
+ * is measured before the timer starts, and the first gather's decision
+ * is reused by any later ones.
+ *
+ * x and y are checked with Print_stats instead of being gathered:
+ * every process summarizes its block in one pass (count, min, max,
+ * mean, variance and a histogram of HIST_BINS bins over
+ * [HIST_MIN, HIST_MAX)), and the summaries are combined with one
+ * MPI_Allreduce using a custom datatype and operation.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 #include <mpi.h>
 
+#define CODEC_CHUNK 4096            /* doubles per codec chunk       */
+#define CODEC_SAMPLE 65536          /* doubles compressed by a probe */
+#define CODEC_PROBE_BYTES (1 << 20) /* ping-pong message size        */
+#define CODEC_PROBE_REPS 10
+
+#define HIST_BINS 16
+#define HIST_MIN 0.0
+#define HIST_MAX 1.0
+#define STATS_BLOCK 1024 /* elements summarized while in cache */
+
+/* Only doubles, so it can be sent as HIST_BINS + 5 MPI_DOUBLEs */
+typedef struct
+{
+    double count, min, max, mean, m2;
+    double hist[HIST_BINS];
+} Vector_stats;
+
 void Check_for_error(int local_ok, char fname[], char message[],
                      MPI_Comm comm);
 void Read_n(int *n_p, int *local_n_p, int my_rank, int comm_sz,
@@ -19,6 +50,22 @@ void Print_vector(double local_b[], int local_n, int n, char title[],
                   int my_rank, MPI_Comm comm);
 void Parallel_vector_sum(double local_x[], double local_y[],
                          double local_z[], int local_n);
+void Local_stats(double local_a[], int local_n, Vector_stats *stats_p);
+void Merge_stats(void *in, void *inout, int *len, MPI_Datatype *datatype);
+void Print_stats(double local_a[], int local_n, char title[], int my_rank,
+                 MPI_Comm comm);
+#ifdef WIRE_COMPRESSION
+int Codec_bound(int count);
+int Compress_block(double a[], int count, unsigned char out[]);
+void Decompress_block(unsigned char in[], int count, double a[]);
+double Link_bandwidth(MPI_Comm comm);
+void Probe_codec(double a[], int count, double *comp_bytes_p,
+                 double *codec_secs_p);
+int Compression_pays(double raw_bytes, double comp_bytes,
+                     double codec_secs, double link_bw);
+void Gather_compressed(double local_b[], double b[], int local_n,
+                       int my_rank, MPI_Comm comm);
+#endif
 
 /*-------------------------------------------------------------------*/
 int main(void)
@@ -39,14 +86,16 @@ int main(void)
     Read_n(&n, &local_n, my_rank, comm_sz, comm);
     srand(time(NULL) + my_rank);
     Allocate_vectors(&local_x, &local_y, &local_z, local_n, comm);
-
+#ifdef WIRE_COMPRESSION
+    Link_bandwidth(comm); /* ping-pong once, outside the timed region */
+#endif
 
     tstart = MPI_Wtime(); // start time
     Generate_random_vector(local_x, local_n);
     Generate_random_vector(local_y, local_n);
     Parallel_vector_sum(local_x, local_y, local_z, local_n);
-    Print_vector(local_x, local_n, n, "Vector x is:", my_rank, comm);
-    Print_vector(local_y, local_n, n, "Vector y is:", my_rank, comm);
+    Print_stats(local_x, local_n, "Vector x is:", my_rank, comm);
+    Print_stats(local_y, local_n, "Vector y is:", my_rank, comm);
     Print_vector(local_z, local_n, n, "The sum is", my_rank, comm);
     tend = MPI_Wtime();   // end time
 
@@ -161,8 +210,12 @@ void Print_vector(
             local_ok = 0;
         Check_for_error(local_ok, fname, "Can't allocate temporary vector",
                         comm);
+#ifdef WIRE_COMPRESSION
+        Gather_compressed(local_b, b, local_n, my_rank, comm);
+#else
         MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE,
                    0, comm);
+#endif
         // printf("%s\n", title);
         // for (i = 0; i < 10 && i < n; i++)
         //     printf("%.3f ", b[i]);
@@ -180,8 +233,12 @@ void Print_vector(
     {
         Check_for_error(local_ok, fname, "Can't allocate temporary vector",
                         comm);
+#ifdef WIRE_COMPRESSION
+        Gather_compressed(local_b, b, local_n, my_rank, comm);
+#else
         MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE, 0,
                    comm);
+#endif
     }
 } /* Print_vector */
 
@@ -196,3 +253,386 @@ void Parallel_vector_sum(
     for (local_i = 0; local_i < local_n; local_i++)
         local_z[local_i] = local_x[local_i] + local_y[local_i];
 } /* Parallel_vector_sum */
+
+/*
+ * Summarize a block in one pass over memory.  Each STATS_BLOCK piece
+ * is summed, its squared deviations are taken while it's still in
+ * cache, and the piece is merged into the running result with Chan's
+ * formula.
+ */
+void Local_stats(
+    double local_a[] /* in  */,
+    int local_n /* in  */,
+    Vector_stats *stats_p /* out */)
+{
+    Vector_stats piece;
+    int start, end, i, bin, len = 1;
+    double sum;
+
+    memset(stats_p, 0, sizeof(Vector_stats));
+    stats_p->min = HUGE_VAL;
+    stats_p->max = -HUGE_VAL;
+    for (start = 0; start < local_n; start += STATS_BLOCK)
+    {
+        end = start + STATS_BLOCK < local_n ? start + STATS_BLOCK : local_n;
+        memset(&piece, 0, sizeof(piece));
+        piece.count = end - start;
+        piece.min = HUGE_VAL;
+        piece.max = -HUGE_VAL;
+
+        sum = 0.0;
+        for (i = start; i < end; i++)
+        {
+            sum += local_a[i];
+            if (local_a[i] < piece.min)
+                piece.min = local_a[i];
+            if (local_a[i] > piece.max)
+                piece.max = local_a[i];
+            bin = (int)((local_a[i] - HIST_MIN) / (HIST_MAX - HIST_MIN) *
+                        HIST_BINS);
+            if (bin < 0)
+                bin = 0;
+            if (bin >= HIST_BINS)
+                bin = HIST_BINS - 1;
+            piece.hist[bin]++;
+        }
+        piece.mean = sum / piece.count;
+        for (i = start; i < end; i++)
+            piece.m2 += (local_a[i] - piece.mean) * (local_a[i] - piece.mean);
+
+        Merge_stats(&piece, stats_p, &len, NULL);
+    }
+} /* Local_stats */
+
+/* MPI_User_function that merges len summaries of in into inout */
+void Merge_stats(
+    void *in /* in     */,
+    void *inout /* in/out */,
+    int *len /* in     */,
+    MPI_Datatype *datatype /* in     */)
+{
+    Vector_stats *a = in, *b = inout;
+    double count, delta;
+    int i, bin;
+
+    for (i = 0; i < *len; i++, a++, b++)
+    {
+        count = a->count + b->count;
+        if (count == 0.0)
+            continue;
+        delta = a->mean - b->mean;
+        b->mean += delta * a->count / count;
+        b->m2 += a->m2 + delta * delta * a->count * b->count / count;
+        b->count = count;
+        if (a->min < b->min)
+            b->min = a->min;
+        if (a->max > b->max)
+            b->max = a->max;
+        for (bin = 0; bin < HIST_BINS; bin++)
+            b->hist[bin] += a->hist[bin];
+    }
+} /* Merge_stats */
+
+void Print_stats(
+    double local_a[] /* in */,
+    int local_n /* in */,
+    char title[] /* in */,
+    int my_rank /* in */,
+    MPI_Comm comm /* in */)
+{
+    Vector_stats local_stats, stats;
+    MPI_Datatype stats_type;
+    MPI_Op merge_op;
+    int bin;
+
+    MPI_Type_contiguous(sizeof(Vector_stats) / sizeof(double), MPI_DOUBLE,
+                        &stats_type);
+    MPI_Type_commit(&stats_type);
+    MPI_Op_create(Merge_stats, 1, &merge_op);
+
+    Local_stats(local_a, local_n, &local_stats);
+    MPI_Allreduce(&local_stats, &stats, 1, stats_type, merge_op, comm);
+
+    MPI_Op_free(&merge_op);
+    MPI_Type_free(&stats_type);
+
+    if (my_rank == 0)
+    {
+        printf("%s\n", title);
+        printf("n = %.0f, min = %.3f, max = %.3f, mean = %.3f, "
+               "variance = %.3f\n",
+               stats.count, stats.min, stats.max, stats.mean,
+               stats.count > 1 ? stats.m2 / (stats.count - 1) : 0.0);
+        for (bin = 0; bin < HIST_BINS; bin++)
+            printf("%.0f ", stats.hist[bin]);
+        printf("\n");
+    }
+} /* Print_stats */
+
+#ifdef WIRE_COMPRESSION
+int Codec_bound(int count /* in */)
+{
+    int bytes = count * sizeof(double);
+
+    return bytes + bytes / 128 + count / CODEC_CHUNK + 1;
+} /* Codec_bound */
+
+int Compress_block(
+    double a[] /* in  */,
+    int count /* in  */,
+    unsigned char out[] /* out */)
+{
+    unsigned char shuffled[CODEC_CHUNK * sizeof(double)];
+    uint64_t prev, cur;
+    int start, chunk, i, k, bytes, run, lit;
+    int out_sz = 0;
+
+    for (start = 0; start < count; start += CODEC_CHUNK)
+    {
+        chunk = count - start < CODEC_CHUNK ? count - start : CODEC_CHUNK;
+        prev = 0;
+        for (i = 0; i < chunk; i++)
+        {
+            memcpy(&cur, &a[start+i], sizeof(cur));
+            for (k = 0; k < sizeof(double); k++)
+                shuffled[k * chunk + i] = (unsigned char) ((cur ^ prev) >> 8 * k);
+            prev = cur;
+        }
+
+        bytes = chunk * sizeof(double);
+        i = lit = 0;
+        while (i < bytes)
+        {
+            for (run = 1; i + run < bytes && run < 128 &&
+                    shuffled[i+run] == shuffled[i]; run++);
+            if (run >= 3)
+            {
+                if (lit > 0)
+                {
+                    out[out_sz++] = lit - 1;
+                    memcpy(out + out_sz, shuffled + i - lit, lit);
+                    out_sz += lit;
+                    lit = 0;
+                }
+                out[out_sz++] = 127 + run;
+                out[out_sz++] = shuffled[i];
+                i += run;
+            }
+            else
+            {
+                lit++;
+                i++;
+                if (lit == 128 || i == bytes)
+                {
+                    out[out_sz++] = lit - 1;
+                    memcpy(out + out_sz, shuffled + i - lit, lit);
+                    out_sz += lit;
+                    lit = 0;
+                }
+            }
+        }
+    }
+
+    return out_sz;
+} /* Compress_block */
+
+void Decompress_block(
+    unsigned char in[] /* in  */,
+    int count /* in  */,
+    double a[] /* out */)
+{
+    unsigned char shuffled[CODEC_CHUNK * sizeof(double)];
+    uint64_t prev, cur;
+    int start, chunk, i, k, bytes, len;
+    int in_pos = 0;
+
+    for (start = 0; start < count; start += CODEC_CHUNK)
+    {
+        chunk = count - start < CODEC_CHUNK ? count - start : CODEC_CHUNK;
+        bytes = chunk * sizeof(double);
+        i = 0;
+        while (i < bytes)
+        {
+            if (in[in_pos] < 128)
+            {
+                len = in[in_pos++] + 1;
+                memcpy(shuffled + i, in + in_pos, len);
+                in_pos += len;
+            }
+            else
+            {
+                len = in[in_pos++] - 127;
+                memset(shuffled + i, in[in_pos++], len);
+            }
+            i += len;
+        }
+
+        prev = 0;
+        for (i = 0; i < chunk; i++)
+        {
+            cur = 0;
+            for (k = 0; k < sizeof(double); k++)
+                cur |= (uint64_t) shuffled[k * chunk + i] << 8 * k;
+            cur ^= prev;
+            memcpy(&a[start+i], &cur, sizeof(cur));
+            prev = cur;
+        }
+    }
+} /* Decompress_block */
+
+double Link_bandwidth(MPI_Comm comm /* in */)
+{
+    static double bw = 0.0;
+    unsigned char *buf;
+    double start, elapsed;
+    int my_rank, comm_sz, rep;
+    int local_ok = 1;
+    char *fname = "Link_bandwidth";
+
+    if (bw > 0.0)
+        return bw;
+    MPI_Comm_size(comm, &comm_sz);
+    MPI_Comm_rank(comm, &my_rank);
+    if (comm_sz == 1)
+        return bw = HUGE_VAL;
+
+    buf = malloc(CODEC_PROBE_BYTES);
+    if (buf == NULL)
+        local_ok = 0;
+    Check_for_error(local_ok, fname, "Can't allocate probe buffer", comm);
+    memset(buf, 0, CODEC_PROBE_BYTES);
+
+    MPI_Barrier(comm);
+    start = MPI_Wtime();
+    for (rep = 0; rep < CODEC_PROBE_REPS; rep++)
+    {
+        if (my_rank == 0)
+        {
+            MPI_Send(buf, CODEC_PROBE_BYTES, MPI_UNSIGNED_CHAR, comm_sz-1, 0,
+                    comm);
+            MPI_Recv(buf, CODEC_PROBE_BYTES, MPI_UNSIGNED_CHAR, comm_sz-1, 0,
+                    comm, MPI_STATUS_IGNORE);
+        }
+        else if (my_rank == comm_sz-1)
+        {
+            MPI_Recv(buf, CODEC_PROBE_BYTES, MPI_UNSIGNED_CHAR, 0, 0, comm,
+                    MPI_STATUS_IGNORE);
+            MPI_Send(buf, CODEC_PROBE_BYTES, MPI_UNSIGNED_CHAR, 0, 0, comm);
+        }
+    }
+    elapsed = MPI_Wtime() - start;
+    free(buf);
+
+    if (my_rank == 0)
+        bw = 2.0 * CODEC_PROBE_REPS * CODEC_PROBE_BYTES / elapsed;
+    MPI_Bcast(&bw, 1, MPI_DOUBLE, 0, comm);
+    return bw;
+} /* Link_bandwidth */
+
+void Probe_codec(
+    double a[] /* in  */,
+    int count /* in  */,
+    double *comp_bytes_p /* out */,
+    double *codec_secs_p /* out */)
+{
+    int sample = count < CODEC_SAMPLE ? count : CODEC_SAMPLE;
+    unsigned char *comp = malloc(Codec_bound(sample));
+    double *check = malloc(sample * sizeof(double));
+    double start, scale = (double) count / sample;
+
+    *comp_bytes_p = (double) count * sizeof(double);
+    *codec_secs_p = HUGE_VAL;
+    if (sample > 0 && comp != NULL && check != NULL)
+    {
+        start = MPI_Wtime();
+        *comp_bytes_p = scale * Compress_block(a, sample, comp);
+        Decompress_block(comp, sample, check);
+        *codec_secs_p = scale * (MPI_Wtime() - start);
+    }
+    free(comp);
+    free(check);
+} /* Probe_codec */
+
+int Compression_pays(
+    double raw_bytes /* in */,
+    double comp_bytes /* in */,
+    double codec_secs /* in */,
+    double link_bw /* in */)
+{
+    return comp_bytes / link_bw + codec_secs < raw_bytes / link_bw;
+} /* Compression_pays */
+
+void Gather_compressed(
+    double local_b[] /* in  */,
+    double b[] /* out */,
+    int local_n /* in  */,
+    int my_rank /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    static int use_codec = -1; /* decided by the first gather */
+    double link_bw = Link_bandwidth(comm);
+    double est[3], total[3];
+    unsigned char *comp = NULL, *local_comp;
+    int *sizes = NULL, *displs = NULL;
+    int local_sz, comm_sz, q;
+    int local_ok = 1;
+    char *fname = "Gather_compressed";
+
+    MPI_Comm_size(comm, &comm_sz);
+    if (use_codec < 0)
+    {
+        /* Every process has the same link_bw, so an infinite one
+         * (a single process) rules the codec out without a reduction */
+        use_codec = 0;
+        if (link_bw < HUGE_VAL)
+        {
+            est[0] = (double) local_n * sizeof(double);
+            Probe_codec(local_b, local_n, &est[1], &est[2]);
+            MPI_Allreduce(est, total, 3, MPI_DOUBLE, MPI_SUM, comm);
+            use_codec = Compression_pays(total[0], total[1], total[2],
+                    link_bw);
+        }
+#ifdef DEBUG
+        if (my_rank == 0)
+            printf("Proc 0 > In %s, compression %s\n", fname,
+                    use_codec ? "on" : "off");
+#endif
+    }
+    if (!use_codec)
+    {
+        MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE,
+                0, comm);
+        return;
+    }
+
+    local_comp = malloc(Codec_bound(local_n));
+    if (local_comp == NULL)
+        local_ok = 0;
+    if (my_rank == 0)
+    {
+        comp = malloc((size_t) comm_sz * Codec_bound(local_n));
+        sizes = malloc(comm_sz * sizeof(int));
+        displs = malloc(comm_sz * sizeof(int));
+        if (comp == NULL || sizes == NULL || displs == NULL)
+            local_ok = 0;
+    }
+    Check_for_error(local_ok, fname, "Can't allocate temporary storage",
+            comm);
+
+    local_sz = Compress_block(local_b, local_n, local_comp);
+    MPI_Gather(&local_sz, 1, MPI_INT, sizes, 1, MPI_INT, 0, comm);
+    if (my_rank == 0)
+        for (q = 0; q < comm_sz; q++)
+            displs[q] = q == 0 ? 0 : displs[q-1] + sizes[q-1];
+    MPI_Gatherv(local_comp, local_sz, MPI_UNSIGNED_CHAR, comp, sizes,
+            displs, MPI_UNSIGNED_CHAR, 0, comm);
+    if (my_rank == 0)
+        for (q = 0; q < comm_sz; q++)
+            Decompress_block(comp + displs[q], local_n, b + q * local_n);
+
+    free(local_comp);
+    free(comp);
+    free(sizes);
+    free(displs);
+} /* Gather_compressed */
+#endif
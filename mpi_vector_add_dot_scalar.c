@@ -1,13 +1,94 @@
 /*
- * Compile:  mpicc mpi_vector_add_dot_scalar.c -o mpi_vector_add_dot_scalar
+ * Compile:  mpicc -O3 -ffp-contract=off mpi_vector_add_dot_scalar.c -o mpi_vector_add_dot_scalar -lm
  * Run:      mpiexec -n N ./mpi_vector_add_dot_scalar
+ *
+ * The generation, the operations and the gathers that print the
+ * vectors are declared as a task graph with their data dependencies
+ * and run by Run_task_graph:  each gather is started with MPI_Igather
+ * as soon as its vector is ready, so it proceeds while the remaining
+ * vectors are computed.  Only MAX_GATHERS gathers are in flight at a
+ * time, so process 0 doesn't hold more n-element buffers than the
+ * sequential version.
+ *
+ * The elementwise products are also summed into the global dot
+ * product twice:  with Fast_sum (local sums and MPI_SUM), whose bits
+ * depend on comm_sz, and with Reproducible_sum, whose bits don't.
+ * After the task graph has finished, and outside its timing, each sum
+ * is timed over REDUCE_REPS more calls on the final vectors, which
+ * cost the same.  Don't compile with -ffast-math:  Reproducible_sum
+ * relies on (M + r) - M being evaluated as written.  For the same
+ * reason M + a*b mustn't be fused into one multiply-add, which GCC
+ * does by default when the target has FMA instructions (e.g. with
+ * -march=native):  the file asks for no contraction with pragmas, and
+ * -ffp-contract=off makes sure of it.
+ *
+ * Compiled with -DFIXED_SEED element i of x and y is a hash of i
+ * instead of a rand() value seeded by the time and the rank, so the
+ * vectors are the same on every run and for every comm_sz, and the
+ * reproducible sum must print the same digits for any N.
+ *
+ * Compiled with -DLOW_MEMORY only x, y and a are allocated.  The sum
+ * and y*scalar are computed in place (x += y, y *= scalar) once
+ * everything that reads the old values has finished, including the
+ * gathers that print them, and the elementwise products, which are
+ * only consumed by the reductions, are never stored:  they are
+ * computed inside Fast_sum and Reproducible_sum.  The peak resident
+ * memory of the processes is printed at the end in both builds:  with
+ * n = 4000000 on 2 processes, process 0 peaks at about 90 MB with
+ * -DLOW_MEMORY and 136 MB without it, the same as the original
+ * program, which allocated all six vectors and one gather buffer.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <time.h>
+#include <sys/resource.h>
+#include <stdint.h>
 #include <mpi.h>
 
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off") /* GCC ignores the STDC one */
+#else
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+#define TASK(t) (1u << (t))
+
+#define REPRO_FOLDS 3
+#define REPRO_LANES 4
+#define REDUCE_REPS 10
+#define MAX_GATHERS 1
+
+/* Everything the tasks read and write */
+typedef struct
+{
+    double *local_x, *local_y, *local_z, *local_w, *local_a, *local_b;
+    int n, local_n, scalar, my_rank;
+    MPI_Comm comm;
+    double dot_fast, dot_repro, fast_time, repro_time;
+} Task_data;
+
+/* A gather started by Start_print_vector */
+typedef struct
+{
+    double *b;
+    char *title;
+    MPI_Request req;
+} Print_request;
+
+/* A compute task runs compute, a print task gathers and prints
+   *print_src_p.  deps is a TASK() mask of tasks that must finish
+   before this one starts. */
+typedef struct
+{
+    void (*compute)(Task_data *data_p);
+    double **print_src_p;
+    char *title;
+    unsigned deps;
+    Print_request print;
+} Task;
+
 void Check_for_error(int local_ok, char fname[], char message[],
                      MPI_Comm comm);
 void Read_n_scalar(int *n_p, int *local_n_p, int *scalar, int my_rank, int comm_sz,
@@ -17,14 +98,39 @@ void Allocate_vectors(double **local_x_pp, double **local_y_pp,
                       double **local_a_pp, double **local_b_pp,
                       int local_n, MPI_Comm comm);
 void Generate_random_vector(double local_a[], int local_n);
-void Print_vector(double local_b[], int local_n, int n, char title[],
-                  int my_rank, MPI_Comm comm);
+#ifdef FIXED_SEED
+void Generate_fixed_vector(double local_a[], int local_n, long first,
+                           uint64_t stream);
+#endif
+void Start_print_vector(double local_b[], int local_n, int n, char title[],
+                        int my_rank, MPI_Comm comm, Print_request *print_p);
+void Finish_print_vector(Print_request *print_p, int n, int my_rank);
 void Parallel_vector_sum(double local_x[], double local_y[],
                          double local_z[], int local_n);
 void Parallel_dot_product(double local_x[], double local_y[],
                          double local_z[], int local_n);
 void Parallel_scalar_multiplication(double local_x[], int scalar,
                          double local_z[], int local_n);
+void Parallel_vector_sum_inplace(double local_x[], double local_y[],
+                                 int local_n);
+void Parallel_scalar_multiplication_inplace(double local_x[], int scalar,
+                                            int local_n);
+void Generate_x_task(Task_data *data_p);
+void Generate_y_task(Task_data *data_p);
+void Sum_task(Task_data *data_p);
+void Dot_product_task(Task_data *data_p);
+void Scale_x_task(Task_data *data_p);
+void Scale_y_task(Task_data *data_p);
+void Sum_inplace_task(Task_data *data_p);
+void Scale_y_inplace_task(Task_data *data_p);
+void Dot_sum_task(Task_data *data_p);
+double Fast_sum(double local_a[], double local_b[], int local_n,
+                MPI_Comm comm);
+double Reproducible_sum(double local_a[], double local_b[], int local_n,
+                        int n, MPI_Comm comm);
+void Time_sums(Task_data *data_p);
+void Run_task_graph(Task tasks[], int task_count, Task_data *data_p);
+void Print_peak_memory(int my_rank, MPI_Comm comm);
 
 /*-------------------------------------------------------------------*/
 int main(void)
@@ -34,6 +140,55 @@ int main(void)
     double *local_x, *local_y, *local_z, *local_w, *local_a, *local_b;
     MPI_Comm comm;
     double tstart, tend;
+    Task_data data;
+
+    /* Gen x and gen y share rand()'s state, so y waits for x */
+#ifdef LOW_MEMORY
+    /* x and y are overwritten in place, so SUM waits for everything
+       that reads the old x, and SCALE_Y for everything that reads the
+       old y */
+    enum { GEN_X, PRINT_X, GEN_Y, PRINT_Y, DOT_SUM, SCALE_X, PRINT_A, SUM,
+           PRINT_Z, SCALE_Y, PRINT_B, TASK_COUNT };
+    Task tasks[TASK_COUNT] = {
+        [GEN_X]   = {Generate_x_task, NULL, NULL, 0},
+        [PRINT_X] = {NULL, &data.local_x, "Vector x is:", TASK(GEN_X)},
+        [GEN_Y]   = {Generate_y_task, NULL, NULL, TASK(GEN_X)},
+        [PRINT_Y] = {NULL, &data.local_y, "Vector y is:", TASK(GEN_Y)},
+        [DOT_SUM] = {Dot_sum_task, NULL, NULL, TASK(GEN_X) | TASK(GEN_Y)},
+        [SCALE_X] = {Scale_x_task, NULL, NULL, TASK(GEN_X)},
+        [PRINT_A] = {NULL, &data.local_a, "The product of x by scalar is",
+                     TASK(SCALE_X)},
+        [SUM]     = {Sum_inplace_task, NULL, NULL,
+                     TASK(GEN_Y) | TASK(PRINT_X) | TASK(DOT_SUM) |
+                     TASK(SCALE_X)},
+        [PRINT_Z] = {NULL, &data.local_x, "The sum is", TASK(SUM)},
+        [SCALE_Y] = {Scale_y_inplace_task, NULL, NULL,
+                     TASK(PRINT_Y) | TASK(DOT_SUM) | TASK(SUM)},
+        [PRINT_B] = {NULL, &data.local_y, "The product of y by scalar is",
+                     TASK(SCALE_Y)},
+    };
+#else
+    enum { GEN_X, PRINT_X, GEN_Y, PRINT_Y, SUM, PRINT_Z, DOT, PRINT_W,
+           DOT_SUM, SCALE_X, PRINT_A, SCALE_Y, PRINT_B, TASK_COUNT };
+    Task tasks[TASK_COUNT] = {
+        [GEN_X]   = {Generate_x_task, NULL, NULL, 0},
+        [PRINT_X] = {NULL, &data.local_x, "Vector x is:", TASK(GEN_X)},
+        [GEN_Y]   = {Generate_y_task, NULL, NULL, TASK(GEN_X)},
+        [PRINT_Y] = {NULL, &data.local_y, "Vector y is:", TASK(GEN_Y)},
+        [SUM]     = {Sum_task, NULL, NULL, TASK(GEN_X) | TASK(GEN_Y)},
+        [PRINT_Z] = {NULL, &data.local_z, "The sum is", TASK(SUM)},
+        [DOT]     = {Dot_product_task, NULL, NULL,
+                     TASK(GEN_X) | TASK(GEN_Y)},
+        [PRINT_W] = {NULL, &data.local_w, "The dot product is", TASK(DOT)},
+        [DOT_SUM] = {Dot_sum_task, NULL, NULL, TASK(DOT)},
+        [SCALE_X] = {Scale_x_task, NULL, NULL, TASK(GEN_X)},
+        [PRINT_A] = {NULL, &data.local_a, "The product of x by scalar is",
+                     TASK(SCALE_X)},
+        [SCALE_Y] = {Scale_y_task, NULL, NULL, TASK(GEN_Y)},
+        [PRINT_B] = {NULL, &data.local_b, "The product of y by scalar is",
+                     TASK(SCALE_Y)},
+    };
+#endif
 
     srand(time(NULL));
 
@@ -46,27 +201,35 @@ int main(void)
     srand(time(NULL)+my_rank);
     Allocate_vectors(&local_x, &local_y, &local_z, &local_w, &local_a, &local_b, local_n, comm);
 
+    data.local_x = local_x;
+    data.local_y = local_y;
+    data.local_z = local_z;
+    data.local_w = local_w;
+    data.local_a = local_a;
+    data.local_b = local_b;
+    data.n = n;
+    data.local_n = local_n;
+    data.scalar = scalar;
+    data.my_rank = my_rank;
+    data.comm = comm;
 
     tstart = MPI_Wtime();
-    
-    Generate_random_vector(local_x, local_n);
-    Generate_random_vector(local_y, local_n);
-
-    Parallel_vector_sum(local_x, local_y, local_z, local_n);
-    Parallel_dot_product(local_x, local_y, local_w, local_n);
-    Parallel_scalar_multiplication(local_x, scalar, local_a, local_n);
-    Parallel_scalar_multiplication(local_y, scalar, local_b, local_n);
-
+    Run_task_graph(tasks, TASK_COUNT, &data);
     tend = MPI_Wtime();
+    Time_sums(&data);
 
-    Print_vector(local_x, local_n, n, "Vector x is:", my_rank, comm);
-    Print_vector(local_y, local_n, n, "Vector y is:", my_rank, comm);
-    Print_vector(local_z, local_n, n, "The sum is", my_rank, comm);
-    Print_vector(local_w, local_n, n, "The dot product is", my_rank, comm);
-    Print_vector(local_a, local_n, n, "The product of x by scalar is", my_rank, comm);
-    Print_vector(local_b, local_n, n, "The product of y by scalar is", my_rank, comm);
     if (my_rank == 0)
+    {
+        printf("Sum of the dot product:  %.17g (fast)\n", data.dot_fast);
+        printf("                         %.17g (reproducible)\n",
+               data.dot_repro);
+        printf("Fast sum took %f ms, reproducible sum took %f ms (%.2fx)\n",
+               data.fast_time * 1000 / REDUCE_REPS,
+               data.repro_time * 1000 / REDUCE_REPS,
+               data.repro_time / data.fast_time);
         printf("\nTook %f seconds to run\n", tend - tstart);
+    }
+    Print_peak_memory(my_rank, comm);
 
     free(local_x);
     free(local_y);
@@ -146,15 +309,22 @@ void Allocate_vectors(
 
     *local_x_pp = malloc(local_n * sizeof(double));
     *local_y_pp = malloc(local_n * sizeof(double));
+    *local_a_pp = malloc(local_n * sizeof(double));
+#ifdef LOW_MEMORY
+    /* z and b live in x and y, w is never stored */
+    *local_z_pp = *local_w_pp = *local_b_pp = NULL;
+    if (*local_x_pp == NULL || *local_y_pp == NULL || *local_a_pp == NULL)
+        local_ok = 0;
+#else
     *local_z_pp = malloc(local_n * sizeof(double));
     *local_w_pp = malloc(local_n * sizeof(double));
-    *local_a_pp = malloc(local_n * sizeof(double));
     *local_b_pp = malloc(local_n * sizeof(double));
 
     if (*local_x_pp == NULL || *local_y_pp == NULL ||
         *local_z_pp == NULL || *local_w_pp == NULL ||
         *local_a_pp == NULL || *local_b_pp == NULL)
         local_ok = 0;
+#endif
     Check_for_error(local_ok, fname, "Can't allocate local vector(s)",
                     comm);
 } /* Allocate_vectors */
@@ -169,33 +339,69 @@ void Generate_random_vector(
         local_a[i] = (double)rand() / (double)RAND_MAX;
 } /* Generate_random_vector */
 
-void Print_vector(
-    double local_b[] /* in */,
-    int local_n /* in */,
-    int n /* in */,
-    char title[] /* in */,
-    int my_rank /* in */,
-    MPI_Comm comm /* in */)
+#ifdef FIXED_SEED
+/* Element i is a splitmix64 hash of first + i and stream, in [0, 1) */
+void Generate_fixed_vector(
+    double local_a[] /* out */,
+    int local_n /* in  */,
+    long first /* in  */,
+    uint64_t stream /* in  */)
 {
-
-    double *b = NULL;
+    uint64_t z;
     int i;
+
+    for (i = 0; i < local_n; i++)
+    {
+        z = (uint64_t)(first + i) + stream * 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        local_a[i] = (double)(z >> 11) * 0x1.0p-53;
+    }
+} /* Generate_fixed_vector */
+#endif
+
+void Start_print_vector(
+    double local_b[] /* in  */,
+    int local_n /* in  */,
+    int n /* in  */,
+    char title[] /* in  */,
+    int my_rank /* in  */,
+    MPI_Comm comm /* in  */,
+    Print_request *print_p /* out */)
+{
     int local_ok = 1;
-    char *fname = "Print_vector";
+    char *fname = "Start_print_vector";
 
+    print_p->b = NULL;
+    print_p->title = title;
     if (my_rank == 0)
     {
-        b = malloc(n * sizeof(double));
-        if (b == NULL)
+        print_p->b = malloc(n * sizeof(double));
+        if (print_p->b == NULL)
             local_ok = 0;
-        Check_for_error(local_ok, fname, "Can't allocate temporary vector",
-                        comm);
-        MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE,
-                   0, comm);
-        printf("%s\n", title);
+    }
+    Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+                    comm);
+    MPI_Igather(local_b, local_n, MPI_DOUBLE, print_p->b, local_n,
+                MPI_DOUBLE, 0, comm, &print_p->req);
+} /* Start_print_vector */
+
+void Finish_print_vector(
+    Print_request *print_p /* in/out */,
+    int n /* in     */,
+    int my_rank /* in     */)
+{
+    double *b = print_p->b;
+    int i;
+
+    MPI_Wait(&print_p->req, MPI_STATUS_IGNORE);
+    if (my_rank == 0)
+    {
+        printf("%s\n", print_p->title);
         for (i = 0; i < 10 && i < n; i++)
             printf("%.3f ", b[i]);
-        
+
         if (n > 20)
             printf("... ");
 
@@ -205,14 +411,7 @@ void Print_vector(
         printf("\n");
         free(b);
     }
-    else
-    {
-        Check_for_error(local_ok, fname, "Can't allocate temporary vector",
-                        comm);
-        MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE, 0,
-                   comm);
-    }
-} /* Print_vector */
+} /* Finish_print_vector */
 
 void Parallel_vector_sum(
     double local_x[] /* in  */,
@@ -249,3 +448,335 @@ void Parallel_scalar_multiplication(
     for (local_i = 0; local_i < local_n; local_i++)
         local_z[local_i] = local_x[local_i] * scalar;
 } /* Parallel_vector_sum */
+
+/* x += y.  Each element is read before it's written, so y may be x. */
+void Parallel_vector_sum_inplace(
+    double local_x[] /* in/out */,
+    double local_y[] /* in     */,
+    int local_n /* in     */)
+{
+    int local_i;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        local_x[local_i] += local_y[local_i];
+} /* Parallel_vector_sum_inplace */
+
+void Parallel_scalar_multiplication_inplace(
+    double local_x[] /* in/out */,
+    int scalar /* in     */,
+    int local_n /* in     */)
+{
+    int local_i;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        local_x[local_i] *= scalar;
+} /* Parallel_scalar_multiplication_inplace */
+
+void Generate_x_task(Task_data *data_p /* in/out */)
+{
+#ifdef FIXED_SEED
+    Generate_fixed_vector(data_p->local_x, data_p->local_n,
+                          (long)data_p->my_rank * data_p->local_n, 1);
+#else
+    Generate_random_vector(data_p->local_x, data_p->local_n);
+#endif
+} /* Generate_x_task */
+
+void Generate_y_task(Task_data *data_p /* in/out */)
+{
+#ifdef FIXED_SEED
+    Generate_fixed_vector(data_p->local_y, data_p->local_n,
+                          (long)data_p->my_rank * data_p->local_n, 2);
+#else
+    Generate_random_vector(data_p->local_y, data_p->local_n);
+#endif
+} /* Generate_y_task */
+
+void Sum_task(Task_data *data_p /* in/out */)
+{
+    Parallel_vector_sum(data_p->local_x, data_p->local_y, data_p->local_z,
+                        data_p->local_n);
+} /* Sum_task */
+
+void Dot_product_task(Task_data *data_p /* in/out */)
+{
+    Parallel_dot_product(data_p->local_x, data_p->local_y, data_p->local_w,
+                         data_p->local_n);
+} /* Dot_product_task */
+
+void Scale_x_task(Task_data *data_p /* in/out */)
+{
+    Parallel_scalar_multiplication(data_p->local_x, data_p->scalar,
+                                   data_p->local_a, data_p->local_n);
+} /* Scale_x_task */
+
+void Scale_y_task(Task_data *data_p /* in/out */)
+{
+    Parallel_scalar_multiplication(data_p->local_y, data_p->scalar,
+                                   data_p->local_b, data_p->local_n);
+} /* Scale_y_task */
+
+void Sum_inplace_task(Task_data *data_p /* in/out */)
+{
+    Parallel_vector_sum_inplace(data_p->local_x, data_p->local_y,
+                                data_p->local_n);
+} /* Sum_inplace_task */
+
+void Scale_y_inplace_task(Task_data *data_p /* in/out */)
+{
+    Parallel_scalar_multiplication_inplace(data_p->local_y, data_p->scalar,
+                                           data_p->local_n);
+} /* Scale_y_inplace_task */
+
+/* Sum the products both ways */
+void Dot_sum_task(Task_data *data_p /* in/out */)
+{
+#ifdef LOW_MEMORY
+    double *local_a = data_p->local_x, *local_b = data_p->local_y;
+#else
+    double *local_a = data_p->local_w, *local_b = NULL;
+#endif
+
+    data_p->dot_fast = Fast_sum(local_a, local_b, data_p->local_n,
+                                data_p->comm);
+    data_p->dot_repro = Reproducible_sum(local_a, local_b, data_p->local_n,
+                                         data_p->n, data_p->comm);
+} /* Dot_sum_task */
+
+/*
+ * Time REDUCE_REPS calls of each sum after the task graph has
+ * finished.  With -DLOW_MEMORY x and y then hold the sum and y*scalar
+ * rather than the generated vectors, but the sums cost the same for
+ * any finite values, and their results are thrown away.
+ */
+void Time_sums(Task_data *data_p /* in/out */)
+{
+    double tstart;
+    int rep;
+#ifdef LOW_MEMORY
+    double *local_a = data_p->local_x, *local_b = data_p->local_y;
+#else
+    double *local_a = data_p->local_w, *local_b = NULL;
+#endif
+
+    MPI_Barrier(data_p->comm);
+    tstart = MPI_Wtime();
+    for (rep = 0; rep < REDUCE_REPS; rep++)
+        Fast_sum(local_a, local_b, data_p->local_n, data_p->comm);
+    data_p->fast_time = MPI_Wtime() - tstart;
+
+    MPI_Barrier(data_p->comm);
+    tstart = MPI_Wtime();
+    for (rep = 0; rep < REDUCE_REPS; rep++)
+        Reproducible_sum(local_a, local_b, data_p->local_n, data_p->n,
+                         data_p->comm);
+    data_p->repro_time = MPI_Wtime() - tstart;
+} /* Time_sums */
+
+/* Sum a, or the elementwise products of a and b if b isn't NULL */
+double Fast_sum(
+    double local_a[] /* in */,
+    double local_b[] /* in */,
+    int local_n /* in */,
+    MPI_Comm comm /* in */)
+{
+    double local_sum = 0.0, sum;
+    int local_i;
+
+    if (local_b == NULL)
+        for (local_i = 0; local_i < local_n; local_i++)
+            local_sum += local_a[local_i];
+    else
+        for (local_i = 0; local_i < local_n; local_i++)
+            local_sum += local_a[local_i] * local_b[local_i];
+    MPI_Allreduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return sum;
+} /* Fast_sum */
+
+/* a[i], or a[i]*b[i] if b isn't NULL */
+static inline double Element(
+    double local_a[] /* in */,
+    double local_b[] /* in */,
+    int local_i /* in */)
+{
+    return local_b == NULL ? local_a[local_i]
+                           : local_a[local_i] * local_b[local_i];
+} /* Element */
+
+/*
+ * Sum a distributed vector so that the result has the same bits for
+ * any comm_sz.  Every element is split into REPRO_FOLDS slices with
+ * fixed boundaries that depend only on max |a_i| and n:  adding and
+ * subtracting M = 1.5*2^k rounds r to a multiple of 2^(k-52), and the
+ * boundaries are far enough apart that the slices of each fold add up
+ * without rounding error, in any order and on any process.  The
+ * REPRO_FOLDS fold sums are then added smallest first on every
+ * process.  The parts of the elements below the last fold are
+ * dropped, which leaves an error of about n*2^-(50+2W) relative to
+ * max |a_i|, where W = 50 - ceil(log2(n)).  If b isn't NULL the
+ * elementwise products of a and b are summed instead; each product is
+ * rounded once, so the result has the same bits as summing a stored
+ * vector of the products.
+ */
+double Reproducible_sum(
+    double local_a[] /* in */,
+    double local_b[] /* in */,
+    int local_n /* in */,
+    int n /* in */,
+    MPI_Comm comm /* in */)
+{
+    double local_max = 0.0, max, q, sum;
+    double lane_max[REPRO_LANES], r[REPRO_LANES], M[REPRO_FOLDS];
+    double local_folds[REPRO_FOLDS], folds[REPRO_FOLDS];
+    double acc[REPRO_FOLDS][REPRO_LANES];
+    int local_i, f, l, e, log_n, width;
+
+    /* Written as lane-wise "v > m ? v : m" so it maps onto max
+       instructions */
+    for (l = 0; l < REPRO_LANES; l++)
+        lane_max[l] = 0.0;
+    for (local_i = 0; local_i + REPRO_LANES <= local_n;
+         local_i += REPRO_LANES)
+        for (l = 0; l < REPRO_LANES; l++)
+        {
+            q = fabs(Element(local_a, local_b, local_i + l));
+            lane_max[l] = q > lane_max[l] ? q : lane_max[l];
+        }
+    for (; local_i < local_n; local_i++)
+    {
+        q = fabs(Element(local_a, local_b, local_i));
+        lane_max[0] = q > lane_max[0] ? q : lane_max[0];
+    }
+    for (l = 0; l < REPRO_LANES; l++)
+        if (lane_max[l] > local_max)
+            local_max = lane_max[l];
+    MPI_Allreduce(&local_max, &max, 1, MPI_DOUBLE, MPI_MAX, comm);
+    /* Sums of infinities and NaNs don't depend on the order */
+    if (max == 0.0 || !isfinite(max))
+        return Fast_sum(local_a, local_b, local_n, comm);
+
+    frexp(max, &e);
+    for (log_n = 0; (1L << log_n) < n; log_n++)
+        ;
+    width = 50 - log_n;
+    for (f = 0; f < REPRO_FOLDS; f++)
+        M[f] = ldexp(1.5, e + log_n + 1 - f * width);
+
+    /* REPRO_LANES independent accumulators per fold, so the lanes
+       can be processed with SIMD instructions */
+    for (f = 0; f < REPRO_FOLDS; f++)
+        for (l = 0; l < REPRO_LANES; l++)
+            acc[f][l] = 0.0;
+    for (local_i = 0; local_i + REPRO_LANES <= local_n;
+         local_i += REPRO_LANES)
+    {
+        for (l = 0; l < REPRO_LANES; l++)
+            r[l] = Element(local_a, local_b, local_i + l);
+        for (f = 0; f < REPRO_FOLDS; f++)
+            for (l = 0; l < REPRO_LANES; l++)
+            {
+                q = (M[f] + r[l]) - M[f];
+                acc[f][l] += q;
+                r[l] -= q;
+            }
+    }
+    for (; local_i < local_n; local_i++)
+    {
+        r[0] = Element(local_a, local_b, local_i);
+        for (f = 0; f < REPRO_FOLDS; f++)
+        {
+            q = (M[f] + r[0]) - M[f];
+            acc[f][0] += q;
+            r[0] -= q;
+        }
+    }
+
+    for (f = 0; f < REPRO_FOLDS; f++)
+    {
+        local_folds[f] = 0.0;
+        for (l = 0; l < REPRO_LANES; l++)
+            local_folds[f] += acc[f][l];
+    }
+    MPI_Allreduce(local_folds, folds, REPRO_FOLDS, MPI_DOUBLE, MPI_SUM,
+                  comm);
+
+    sum = 0.0;
+    for (f = REPRO_FOLDS - 1; f >= 0; f--)
+        sum += folds[f];
+    return sum;
+} /* Reproducible_sum */
+
+/*
+ * Run the tasks in dependency order.  Repeatedly take the first task
+ * in the table whose dependencies have finished:  run it if it's a
+ * compute task, or start its gather if it's a print task, and then
+ * poke the gathers in flight so they make progress.  Each gather holds
+ * an n-element buffer on process 0, so at most MAX_GATHERS are in
+ * flight:  a print task that would start another one, or a pass with
+ * nothing ready, first finishes the gather in flight that comes first
+ * in the table.  Which task runs next depends only on the table, never
+ * on when messages arrive, so every process starts the collectives in
+ * the same order.
+ */
+void Run_task_graph(
+    Task tasks[] /* in/out */,
+    int task_count /* in     */,
+    Task_data *data_p /* in/out */)
+{
+    unsigned started = 0, finished = 0, all = TASK(task_count) - 1;
+    int t, u, flag, in_flight = 0;
+
+    while (finished != all)
+    {
+        for (t = 0; t < task_count; t++)
+            if (!(started & TASK(t)) && !(tasks[t].deps & ~finished))
+                break;
+
+        if (t == task_count ||
+            (tasks[t].compute == NULL && in_flight == MAX_GATHERS))
+        {
+            for (u = 0; !(started & ~finished & TASK(u)); u++)
+                ;
+            Finish_print_vector(&tasks[u].print, data_p->n,
+                                data_p->my_rank);
+            finished |= TASK(u);
+            in_flight--;
+            continue;
+        }
+
+        started |= TASK(t);
+        if (tasks[t].compute != NULL)
+        {
+            tasks[t].compute(data_p);
+            finished |= TASK(t);
+        }
+        else
+        {
+            Start_print_vector(*tasks[t].print_src_p, data_p->local_n,
+                               data_p->n, tasks[t].title,
+                               data_p->my_rank, data_p->comm,
+                               &tasks[t].print);
+            in_flight++;
+        }
+        for (u = 0; u < task_count; u++)
+            if (started & ~finished & TASK(u))
+                MPI_Test(&tasks[u].print.req, &flag, MPI_STATUS_IGNORE);
+    }
+} /* Run_task_graph */
+
+/* Peak resident set of the largest process and of all of them, in MB */
+void Print_peak_memory(
+    int my_rank /* in */,
+    MPI_Comm comm /* in */)
+{
+    struct rusage usage;
+    double local_mb, max_mb, total_mb;
+
+    getrusage(RUSAGE_SELF, &usage);
+    local_mb = usage.ru_maxrss / 1024.0; /* ru_maxrss is in KB */
+    MPI_Reduce(&local_mb, &max_mb, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(&local_mb, &total_mb, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    if (my_rank == 0)
+        printf("Peak resident memory:  %.1f MB per process (max), "
+               "%.1f MB total\n", max_mb, total_mb);
+} /* Print_peak_memory */
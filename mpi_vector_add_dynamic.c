@@ -0,0 +1,413 @@
+/*
+ * Compile:  mpicc -O2 mpi_vector_add_dynamic.c -o mpi_vector_add_dynamic
+ * Run:      mpiexec -n N ./mpi_vector_add_dynamic
+ *
+ * Vector addition with dynamic load balancing.  x, y and z have the
+ * block distribution of mpi_vector_add.c:  each process holds its
+ * local_n = n/comm_sz elements in MPI windows, split into chunks of
+ * CHUNK_SIZE elements.  In the static schedule each process adds the
+ * chunks of its own block, without communication.  In the dynamic
+ * schedule every process also has a counter of the next unclaimed
+ * chunk of its block.  A process claims its own chunks from its
+ * counter with MPI_Fetch_and_op, so it never takes one a thief has
+ * already claimed, and adds them locally.  When its block runs out it
+ * steals the chunks left in the other blocks through their counters,
+ * moving x, y and z with MPI_Get/MPI_Put, so faster processes do more
+ * of the work.  The program prints the chunks and busy time of every
+ * process, and the imbalance (slowest time / mean time) of each
+ * schedule.
+ *
+ * A process reads and writes its own block directly while the others
+ * access it with RMA, so the program calls MPI_Win_sync wherever the
+ * separate memory model needs the private and public copies of a
+ * window to agree:  after the local stores that initialize the
+ * windows, after a process has added its own chunks, and before it
+ * reads the z that the thieves have put.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+#define CHUNK_SIZE 65536
+
+void Check_for_error(int local_ok, char fname[], char message[],
+                     MPI_Comm comm);
+void Read_n(int *n_p, int *local_n_p, int my_rank, int comm_sz,
+            MPI_Comm comm);
+void Create_windows(double **local_x_pp, double **local_y_pp,
+                    double **local_z_pp, int **counter_pp,
+                    MPI_Win *x_win_p, MPI_Win *y_win_p, MPI_Win *z_win_p,
+                    MPI_Win *counter_win_p, int local_n, MPI_Comm comm);
+void Add_local_chunk(int chunk, int local_n, double local_x[],
+                     double local_y[], double local_z[]);
+void Add_remote_chunk(int owner, int chunk, int local_n, double chunk_x[],
+                      double chunk_y[], double chunk_z[], MPI_Win x_win,
+                      MPI_Win y_win, MPI_Win z_win);
+int Claim_chunk(int owner, int local_n, MPI_Win counter_win);
+int Static_schedule(int local_n, double local_x[], double local_y[],
+                    double local_z[]);
+int Dynamic_schedule(int local_n, int my_rank, int comm_sz,
+                     double local_x[], double local_y[], double local_z[],
+                     double chunk_x[], double chunk_y[], double chunk_z[],
+                     MPI_Win x_win, MPI_Win y_win, MPI_Win z_win,
+                     MPI_Win counter_win);
+void Check_sum(double local_z[], int local_n, int my_rank, MPI_Comm comm);
+double Print_schedule(char title[], int chunks, double elapsed,
+                      int my_rank, int comm_sz, MPI_Comm comm);
+
+/*-------------------------------------------------------------------*/
+int main(void)
+{
+    int n, local_n, chunks, local_i;
+    int comm_sz, my_rank;
+    double *local_x, *local_y, *local_z, *chunk_x, *chunk_y, *chunk_z;
+    int *counter;
+    MPI_Win x_win, y_win, z_win, counter_win;
+    MPI_Comm comm;
+    double tstart, static_imbalance, dynamic_imbalance;
+
+    MPI_Init(NULL, NULL);
+    comm = MPI_COMM_WORLD;
+    MPI_Comm_size(comm, &comm_sz);
+    MPI_Comm_rank(comm, &my_rank);
+
+    Read_n(&n, &local_n, my_rank, comm_sz, comm);
+    Create_windows(&local_x, &local_y, &local_z, &counter, &x_win, &y_win,
+                   &z_win, &counter_win, local_n, comm);
+
+    chunk_x = malloc(CHUNK_SIZE * sizeof(double));
+    chunk_y = malloc(CHUNK_SIZE * sizeof(double));
+    chunk_z = malloc(CHUNK_SIZE * sizeof(double));
+    Check_for_error(chunk_x != NULL && chunk_y != NULL && chunk_z != NULL,
+                    "main", "Can't allocate chunk buffers", comm);
+
+    /* z is touched here too, so neither schedule pays its page faults */
+    for (local_i = 0; local_i < local_n; local_i++)
+    {
+        local_x[local_i] = local_y[local_i] =
+            (double)my_rank * local_n + local_i;
+        local_z[local_i] = 0.0;
+    }
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    chunks = Static_schedule(local_n, local_x, local_y, local_z);
+    static_imbalance = Print_schedule("Static schedule", chunks,
+                                      MPI_Wtime() - tstart, my_rank,
+                                      comm_sz, comm);
+    Check_sum(local_z, local_n, my_rank, comm);
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        local_z[local_i] = 0.0;
+    *counter = 0;
+    MPI_Barrier(comm);
+    MPI_Win_lock_all(0, x_win);
+    MPI_Win_lock_all(0, y_win);
+    MPI_Win_lock_all(0, z_win);
+    MPI_Win_lock_all(0, counter_win);
+    MPI_Win_sync(x_win);
+    MPI_Win_sync(y_win);
+    MPI_Win_sync(z_win);
+    MPI_Win_sync(counter_win);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    chunks = Dynamic_schedule(local_n, my_rank, comm_sz, local_x, local_y,
+                              local_z, chunk_x, chunk_y, chunk_z, x_win,
+                              y_win, z_win, counter_win);
+    dynamic_imbalance = Print_schedule("Dynamic schedule", chunks,
+                                       MPI_Wtime() - tstart, my_rank,
+                                       comm_sz, comm);
+
+    /* Every Put has been flushed before the barrier */
+    MPI_Barrier(comm);
+    MPI_Win_sync(z_win);
+    MPI_Win_unlock_all(counter_win);
+    MPI_Win_unlock_all(z_win);
+    MPI_Win_unlock_all(y_win);
+    MPI_Win_unlock_all(x_win);
+    Check_sum(local_z, local_n, my_rank, comm);
+
+    if (my_rank == 0)
+        printf("\nImbalance reduced from %.3f to %.3f\n", static_imbalance,
+               dynamic_imbalance);
+
+    free(chunk_x);
+    free(chunk_y);
+    free(chunk_z);
+    MPI_Win_free(&counter_win);
+    MPI_Win_free(&z_win);
+    MPI_Win_free(&y_win);
+    MPI_Win_free(&x_win);
+
+    MPI_Finalize();
+
+    return 0;
+} /* main */
+
+void Check_for_error(
+    int local_ok /* in */,
+    char fname[] /* in */,
+    char message[] /* in */,
+    MPI_Comm comm /* in */)
+{
+    int ok;
+
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (ok == 0)
+    {
+        int my_rank;
+        MPI_Comm_rank(comm, &my_rank);
+        if (my_rank == 0)
+        {
+            fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+                    message);
+            fflush(stderr);
+        }
+        MPI_Finalize();
+        exit(-1);
+    }
+} /* Check_for_error */
+
+void Read_n(
+    int *n_p /* out */,
+    int *local_n_p /* out */,
+    int my_rank /* in  */,
+    int comm_sz /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Read_n";
+
+    if (my_rank == 0)
+    {
+        printf("What's the order of the vectors?\n");
+        scanf("%d", n_p);
+    }
+    MPI_Bcast(n_p, 1, MPI_INT, 0, comm);
+    if (*n_p <= 0 || *n_p % comm_sz != 0)
+        local_ok = 0;
+    Check_for_error(local_ok, fname,
+                    "n should be > 0 and evenly divisible by comm_sz", comm);
+    *local_n_p = *n_p / comm_sz;
+} /* Read_n */
+
+/*
+ * Allocate the local blocks of x, y and z and this process' chunk
+ * counter in windows, so the other processes can steal chunks.
+ */
+void Create_windows(
+    double **local_x_pp /* out */,
+    double **local_y_pp /* out */,
+    double **local_z_pp /* out */,
+    int **counter_pp /* out */,
+    MPI_Win *x_win_p /* out */,
+    MPI_Win *y_win_p /* out */,
+    MPI_Win *z_win_p /* out */,
+    MPI_Win *counter_win_p /* out */,
+    int local_n /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    MPI_Aint size = (MPI_Aint)local_n * sizeof(double);
+
+    MPI_Win_allocate(size, sizeof(double), MPI_INFO_NULL, comm, local_x_pp,
+                     x_win_p);
+    MPI_Win_allocate(size, sizeof(double), MPI_INFO_NULL, comm, local_y_pp,
+                     y_win_p);
+    MPI_Win_allocate(size, sizeof(double), MPI_INFO_NULL, comm, local_z_pp,
+                     z_win_p);
+    MPI_Win_allocate(sizeof(int), sizeof(int), MPI_INFO_NULL, comm,
+                     counter_pp, counter_win_p);
+} /* Create_windows */
+
+/* Add chunk of this process' block */
+void Add_local_chunk(
+    int chunk /* in  */,
+    int local_n /* in  */,
+    double local_x[] /* in  */,
+    double local_y[] /* in  */,
+    double local_z[] /* out */)
+{
+    int first = chunk * CHUNK_SIZE;
+    int last = local_n - first < CHUNK_SIZE ? local_n : first + CHUNK_SIZE;
+    int local_i;
+
+    for (local_i = first; local_i < last; local_i++)
+        local_z[local_i] = local_x[local_i] + local_y[local_i];
+} /* Add_local_chunk */
+
+/* Fetch chunk of owner's x and y, add them and store owner's z */
+void Add_remote_chunk(
+    int owner /* in  */,
+    int chunk /* in  */,
+    int local_n /* in  */,
+    double chunk_x[] /* out */,
+    double chunk_y[] /* out */,
+    double chunk_z[] /* out */,
+    MPI_Win x_win /* in  */,
+    MPI_Win y_win /* in  */,
+    MPI_Win z_win /* in  */)
+{
+    MPI_Aint first = (MPI_Aint)chunk * CHUNK_SIZE;
+    int count = local_n - first < CHUNK_SIZE ? local_n - first : CHUNK_SIZE;
+    int i;
+
+    MPI_Get(chunk_x, count, MPI_DOUBLE, owner, first, count, MPI_DOUBLE,
+            x_win);
+    MPI_Get(chunk_y, count, MPI_DOUBLE, owner, first, count, MPI_DOUBLE,
+            y_win);
+    MPI_Win_flush(owner, x_win);
+    MPI_Win_flush(owner, y_win);
+
+    for (i = 0; i < count; i++)
+        chunk_z[i] = chunk_x[i] + chunk_y[i];
+
+    MPI_Put(chunk_z, count, MPI_DOUBLE, owner, first, count, MPI_DOUBLE,
+            z_win);
+    MPI_Win_flush(owner, z_win);
+} /* Add_remote_chunk */
+
+/*
+ * Claim the next chunk of owner's block from its counter.  Returns the
+ * chunk, or -1 if the block has none left.
+ */
+int Claim_chunk(
+    int owner /* in  */,
+    int local_n /* in  */,
+    MPI_Win counter_win /* in  */)
+{
+    int block_chunks = (local_n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int one = 1, chunk;
+
+    MPI_Fetch_and_op(&one, &chunk, MPI_INT, owner, 0, MPI_SUM,
+                     counter_win);
+    MPI_Win_flush(owner, counter_win);
+    return chunk < block_chunks ? chunk : -1;
+} /* Claim_chunk */
+
+/*
+ * Add every chunk of this process' block.  Returns the number of
+ * chunks handled.
+ */
+int Static_schedule(
+    int local_n /* in  */,
+    double local_x[] /* in  */,
+    double local_y[] /* in  */,
+    double local_z[] /* out */)
+{
+    int block_chunks = (local_n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int chunk;
+
+    for (chunk = 0; chunk < block_chunks; chunk++)
+        Add_local_chunk(chunk, local_n, local_x, local_y, local_z);
+    return block_chunks;
+} /* Static_schedule */
+
+/*
+ * Claim and add the chunks of this process' block, then steal the
+ * chunks left in the other blocks, starting with the next rank.
+ * Returns the number of chunks handled.
+ */
+int Dynamic_schedule(
+    int local_n /* in  */,
+    int my_rank /* in  */,
+    int comm_sz /* in  */,
+    double local_x[] /* in  */,
+    double local_y[] /* in  */,
+    double local_z[] /* out */,
+    double chunk_x[] /* out */,
+    double chunk_y[] /* out */,
+    double chunk_z[] /* out */,
+    MPI_Win x_win /* in  */,
+    MPI_Win y_win /* in  */,
+    MPI_Win z_win /* in  */,
+    MPI_Win counter_win /* in  */)
+{
+    int chunk, victim, q, count = 0;
+
+    while ((chunk = Claim_chunk(my_rank, local_n, counter_win)) >= 0)
+    {
+        Add_local_chunk(chunk, local_n, local_x, local_y, local_z);
+        count++;
+    }
+    MPI_Win_sync(z_win);
+
+    for (q = 1; q < comm_sz; q++)
+    {
+        victim = (my_rank + q) % comm_sz;
+        while ((chunk = Claim_chunk(victim, local_n, counter_win)) >= 0)
+        {
+            Add_remote_chunk(victim, chunk, local_n, chunk_x, chunk_y,
+                             chunk_z, x_win, y_win, z_win);
+            count++;
+        }
+    }
+    return count;
+} /* Dynamic_schedule */
+
+/* Check that z = x + y = 2*i everywhere */
+void Check_sum(
+    double local_z[] /* in */,
+    int local_n /* in */,
+    int my_rank /* in */,
+    MPI_Comm comm /* in */)
+{
+    int local_i, local_ok = 1;
+
+    for (local_i = 0; local_i < local_n; local_i++)
+        if (local_z[local_i] != 2.0 * ((double)my_rank * local_n + local_i))
+            local_ok = 0;
+    Check_for_error(local_ok, "Check_sum", "Wrong sum", comm);
+} /* Check_sum */
+
+/*
+ * Print the chunks and busy time of every process for one schedule.
+ * Returns the imbalance, slowest time / mean time, on process 0.
+ */
+double Print_schedule(
+    char title[] /* in */,
+    int chunks /* in */,
+    double elapsed /* in */,
+    int my_rank /* in */,
+    int comm_sz /* in */,
+    MPI_Comm comm /* in */)
+{
+    int *all_chunks = NULL;
+    double *all_elapsed = NULL;
+    double max_elapsed = 0.0, sum_elapsed = 0.0;
+    int q;
+    int local_ok = 1;
+    char *fname = "Print_schedule";
+
+    if (my_rank == 0)
+    {
+        all_chunks = malloc(comm_sz * sizeof(int));
+        all_elapsed = malloc(comm_sz * sizeof(double));
+        if (all_chunks == NULL || all_elapsed == NULL)
+            local_ok = 0;
+    }
+    Check_for_error(local_ok, fname, "Can't allocate report", comm);
+    MPI_Gather(&chunks, 1, MPI_INT, all_chunks, 1, MPI_INT, 0, comm);
+    MPI_Gather(&elapsed, 1, MPI_DOUBLE, all_elapsed, 1, MPI_DOUBLE, 0,
+               comm);
+
+    if (my_rank == 0)
+    {
+        printf("%s\n", title);
+        for (q = 0; q < comm_sz; q++)
+        {
+            printf("   Proc %d:  %6d chunks  %10.3f ms\n", q, all_chunks[q],
+                   all_elapsed[q] * 1000);
+            if (all_elapsed[q] > max_elapsed)
+                max_elapsed = all_elapsed[q];
+            sum_elapsed += all_elapsed[q];
+        }
+        printf("   Took %f ms, imbalance %.3f\n", max_elapsed * 1000,
+               max_elapsed / (sum_elapsed / comm_sz));
+        free(all_chunks);
+        free(all_elapsed);
+        return max_elapsed / (sum_elapsed / comm_sz);
+    }
+    return 0.0;
+} /* Print_schedule */
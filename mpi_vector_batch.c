@@ -0,0 +1,489 @@
+/*
+ * Compile:  mpicc -O2 mpi_vector_batch.c -o mpi_vector_batch -lm
+ * Run:      mpiexec -n N ./mpi_vector_batch
+ *
+ * Add and dot k pairs of vectors at once.  Each process stores its
+ * blocks of the k vectors in a blocked (AoSoA) layout:  BATCH_BLOCK
+ * consecutive elements of vector 0, then the same elements of vector
+ * 1, ..., vector k-1, then the next BATCH_BLOCK elements of vector 0,
+ * and so on.  The local block is padded with zeros to a multiple of
+ * BATCH_BLOCK.  A whole batch is distributed with one MPI_Scatter and
+ * collected with one MPI_Gather, and the k dot products are combined
+ * with one MPI_Allreduce.  For comparison the program also processes
+ * the pairs one at a time, with one scatter, gather and reduction per
+ * vector, and checks that both give the same dot products.
+ *
+ * Both versions compute the sum and the dot product in one pass, and
+ * both allocate and touch all their buffers, including process 0's
+ * staging buffers, before the timer starts, so neither is charged for
+ * malloc or first-touch page faults.  Even so, the batched version is
+ * usually the slower one:  its k*n-element buffers are far larger
+ * than the caches, while the one-pair version reuses three n-element
+ * buffers, and a larger message per collective only pays off when
+ * the per-message latency, not the bandwidth, dominates.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+
+#define BATCH_BLOCK 8
+
+void Check_for_error(int local_ok, char fname[], char message[],
+                     MPI_Comm comm);
+void Read_n_k(int *n_p, int *local_n_p, int *k_p, int my_rank,
+              int comm_sz, MPI_Comm comm);
+int Padded_n(int local_n);
+void Allocate_batches(double **local_x_pp, double **local_y_pp,
+                      double **local_z_pp, int k, int local_n,
+                      MPI_Comm comm);
+void Allocate_staging(double **packed_pp, double **gathered_pp, int k,
+                      int local_n, int my_rank, MPI_Comm comm);
+void Fill_vector(double a[], int n, int v, int offset);
+void Read_batch(double local_a[], double packed[], int k, int local_n,
+                int offset, int my_rank, MPI_Comm comm);
+void Gather_batch(double local_b[], double gathered[], int k,
+                  int local_n, MPI_Comm comm);
+void Print_batch(double packed[], int k, int local_n, int n,
+                 char title[]);
+void Batch_sum_dot(double local_x[], double local_y[], double local_z[],
+                   double dots[], int k, int local_n, MPI_Comm comm);
+double One_pair_at_a_time(double dots[], int k, int local_n, int n,
+                          int my_rank, MPI_Comm comm);
+void Check_dots(double dots[], double pair_dots[], int k);
+
+/*-------------------------------------------------------------------*/
+int main(void)
+{
+    int n, local_n, k, v;
+    int comm_sz, my_rank;
+    double *local_x, *local_y, *local_z, *dots, *pair_dots;
+    double *packed, *gathered;
+    MPI_Comm comm;
+    double tstart, tend, pair_time;
+
+    MPI_Init(NULL, NULL);
+    comm = MPI_COMM_WORLD;
+    MPI_Comm_size(comm, &comm_sz);
+    MPI_Comm_rank(comm, &my_rank);
+
+    Read_n_k(&n, &local_n, &k, my_rank, comm_sz, comm);
+    Allocate_batches(&local_x, &local_y, &local_z, k, local_n, comm);
+    Allocate_staging(&packed, &gathered, k, local_n, my_rank, comm);
+    dots = malloc(k * sizeof(double));
+    pair_dots = malloc(k * sizeof(double));
+    Check_for_error(dots != NULL && pair_dots != NULL, "main",
+                    "Can't allocate dot products", comm);
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Read_batch(local_x, packed, k, local_n, 0, my_rank, comm);
+    Read_batch(local_y, packed, k, local_n, 1, my_rank, comm);
+    Batch_sum_dot(local_x, local_y, local_z, dots, k, local_n, comm);
+    Gather_batch(local_z, gathered, k, local_n, comm);
+    tend = MPI_Wtime();
+
+    if (my_rank == 0)
+    {
+        Print_batch(gathered, k, local_n, n, "The sums are");
+        printf("The dot products are\n");
+        for (v = 0; v < k; v++)
+            printf("%.6e ", dots[v]);
+        printf("\n");
+    }
+
+    pair_time = One_pair_at_a_time(pair_dots, k, local_n, n, my_rank,
+                                   comm);
+    if (my_rank == 0)
+    {
+        Check_dots(dots, pair_dots, k);
+        printf("\nBatched:  took %f seconds to run\n", tend - tstart);
+        printf("One pair at a time:  took %f seconds to run\n", pair_time);
+    }
+
+    free(local_x);
+    free(local_y);
+    free(local_z);
+    free(packed);
+    free(gathered);
+    free(dots);
+    free(pair_dots);
+
+    MPI_Finalize();
+
+    return 0;
+} /* main */
+
+void Check_for_error(
+    int local_ok /* in */,
+    char fname[] /* in */,
+    char message[] /* in */,
+    MPI_Comm comm /* in */)
+{
+    int ok;
+
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (ok == 0)
+    {
+        int my_rank;
+        MPI_Comm_rank(comm, &my_rank);
+        if (my_rank == 0)
+        {
+            fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+                    message);
+            fflush(stderr);
+        }
+        MPI_Finalize();
+        exit(-1);
+    }
+} /* Check_for_error */
+
+void Read_n_k(
+    int *n_p /* out */,
+    int *local_n_p /* out */,
+    int *k_p /* out */,
+    int my_rank /* in  */,
+    int comm_sz /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Read_n_k";
+
+    if (my_rank == 0)
+    {
+        printf("What's the order of the vectors?\n");
+        scanf("%d", n_p);
+        printf("How many pairs of vectors?\n");
+        scanf("%d", k_p);
+    }
+    MPI_Bcast(n_p, 1, MPI_INT, 0, comm);
+    MPI_Bcast(k_p, 1, MPI_INT, 0, comm);
+    if (*n_p <= 0 || *n_p % comm_sz != 0 || *k_p <= 0)
+        local_ok = 0;
+    Check_for_error(local_ok, fname,
+                    "n should be > 0 and evenly divisible by comm_sz, "
+                    "and k should be > 0", comm);
+    *local_n_p = *n_p / comm_sz;
+} /* Read_n_k */
+
+/* Size of the local block of one vector, rounded up to whole blocks */
+int Padded_n(int local_n /* in */)
+{
+    return (local_n + BATCH_BLOCK - 1) / BATCH_BLOCK * BATCH_BLOCK;
+} /* Padded_n */
+
+void Allocate_batches(
+    double **local_x_pp /* out */,
+    double **local_y_pp /* out */,
+    double **local_z_pp /* out */,
+    int k /* in  */,
+    int local_n /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Allocate_batches";
+    size_t size = (size_t)k * Padded_n(local_n) * sizeof(double);
+
+    *local_x_pp = malloc(size);
+    *local_y_pp = malloc(size);
+    *local_z_pp = malloc(size);
+
+    if (*local_x_pp == NULL || *local_y_pp == NULL ||
+        *local_z_pp == NULL)
+        local_ok = 0;
+    Check_for_error(local_ok, fname, "Can't allocate local batch(es)",
+                    comm);
+
+    /* Take the page faults now, outside the timed region */
+    memset(*local_x_pp, 0, size);
+    memset(*local_y_pp, 0, size);
+    memset(*local_z_pp, 0, size);
+} /* Allocate_batches */
+
+/*
+ * Allocate and touch process 0's buffers for the whole batch of every
+ * process:  packed is filled and scattered by Read_batch, gathered
+ * receives Gather_batch's result.  Both are NULL on the other
+ * processes.  The padding of packed stays zero.
+ */
+void Allocate_staging(
+    double **packed_pp /* out */,
+    double **gathered_pp /* out */,
+    int k /* in  */,
+    int local_n /* in  */,
+    int my_rank /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Allocate_staging";
+    int comm_sz;
+    size_t size;
+
+    MPI_Comm_size(comm, &comm_sz);
+    size = (size_t)comm_sz * k * Padded_n(local_n) * sizeof(double);
+    *packed_pp = *gathered_pp = NULL;
+    if (my_rank == 0)
+    {
+        *packed_pp = malloc(size);
+        *gathered_pp = malloc(size);
+        if (*packed_pp == NULL || *gathered_pp == NULL)
+            local_ok = 0;
+    }
+    Check_for_error(local_ok, fname, "Can't allocate temporary batch",
+                    comm);
+    if (my_rank == 0)
+    {
+        memset(*packed_pp, 0, size);
+        memset(*gathered_pp, 0, size);
+    }
+} /* Allocate_staging */
+
+/* Vector v of a batch is filled with i + v + offset */
+void Fill_vector(
+    double a[] /* out */,
+    int n /* in  */,
+    int v /* in  */,
+    int offset /* in  */)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        a[i] = i + v + offset;
+} /* Fill_vector */
+
+/*
+ * Fill k vectors on process 0 directly in each process' AoSoA layout,
+ * with the values Fill_vector gives them, and distribute the whole
+ * batch with one MPI_Scatter.
+ */
+void Read_batch(
+    double local_a[] /* out */,
+    double packed[] /* in/out */,
+    int k /* in  */,
+    int local_n /* in  */,
+    int offset /* in  */,
+    int my_rank /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    double *dest;
+    int padded_n = Padded_n(local_n);
+    int comm_sz, q, v, i, j, count;
+
+    MPI_Comm_size(comm, &comm_sz);
+    if (my_rank == 0)
+        for (q = 0; q < comm_sz; q++)
+            for (i = 0; i < local_n; i += BATCH_BLOCK)
+            {
+                count = local_n - i < BATCH_BLOCK ? local_n - i
+                                                  : BATCH_BLOCK;
+                dest = packed + ((size_t)q * padded_n + (size_t)i) * k;
+                for (v = 0; v < k; v++)
+                    for (j = 0; j < count; j++)
+                        dest[v * BATCH_BLOCK + j] =
+                            (double)q * local_n + i + j + v + offset;
+            }
+    MPI_Scatter(packed, k * padded_n, MPI_DOUBLE, local_a, k * padded_n,
+                MPI_DOUBLE, 0, comm);
+} /* Read_batch */
+
+/*
+ * Collect a batch into gathered on process 0 with one MPI_Gather.
+ * The blocks of all the processes stay in the AoSoA layout.
+ */
+void Gather_batch(
+    double local_b[] /* in  */,
+    double gathered[] /* out */,
+    int k /* in  */,
+    int local_n /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int padded_n = Padded_n(local_n);
+
+    MPI_Gather(local_b, k * padded_n, MPI_DOUBLE, gathered, k * padded_n,
+               MPI_DOUBLE, 0, comm);
+} /* Gather_batch */
+
+/* Print the first and last elements of each vector of a gathered batch */
+void Print_batch(
+    double packed[] /* in */,
+    int k /* in */,
+    int local_n /* in */,
+    int n /* in */,
+    char title[] /* in */)
+{
+    double *src;
+    int padded_n = Padded_n(local_n);
+    int v, i, local_i;
+
+    printf("%s\n", title);
+    for (v = 0; v < k; v++)
+    {
+        for (i = 0; i < n; i++)
+        {
+            if (i == 10 && n > 20)
+            {
+                printf("... ");
+                i = n - 10;
+            }
+            src = packed + (size_t)(i / local_n) * k * padded_n;
+            local_i = i % local_n;
+            printf("%.3f ", src[(local_i / BATCH_BLOCK * k + v) *
+                                    BATCH_BLOCK +
+                                local_i % BATCH_BLOCK]);
+        }
+        printf("\n");
+    }
+} /* Print_batch */
+
+/*
+ * Add the pairs and accumulate BATCH_BLOCK partial dot products per
+ * vector in the same pass, so that each BATCH_BLOCK-wide row of the
+ * layout is one contiguous vector operation, then combine the k local
+ * dot products with one MPI_Allreduce.  The padding is zero, so it
+ * adds nothing to the dot products.
+ */
+void Batch_sum_dot(
+    double local_x[] /* in  */,
+    double local_y[] /* in  */,
+    double local_z[] /* out */,
+    double dots[] /* out */,
+    int k /* in  */,
+    int local_n /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int blocks = Padded_n(local_n) / BATCH_BLOCK;
+    double *partial = calloc((size_t)k * BATCH_BLOCK, sizeof(double));
+    double *local_dots = calloc(k, sizeof(double));
+    double *x, *y, *z, *acc;
+    size_t first;
+    int b, v, j;
+
+    Check_for_error(partial != NULL && local_dots != NULL,
+                    "Batch_sum_dot", "Can't allocate partial sums", comm);
+    for (b = 0; b < blocks; b++)
+        for (v = 0; v < k; v++)
+        {
+            first = ((size_t)b * k + v) * BATCH_BLOCK;
+            x = local_x + first;
+            y = local_y + first;
+            z = local_z + first;
+            acc = partial + v * BATCH_BLOCK;
+            for (j = 0; j < BATCH_BLOCK; j++)
+            {
+                z[j] = x[j] + y[j];
+                acc[j] += x[j] * y[j];
+            }
+        }
+    for (v = 0; v < k; v++)
+        for (j = 0; j < BATCH_BLOCK; j++)
+            local_dots[v] += partial[v * BATCH_BLOCK + j];
+    MPI_Allreduce(local_dots, dots, k, MPI_DOUBLE, MPI_SUM, comm);
+
+    free(partial);
+    free(local_dots);
+} /* Batch_sum_dot */
+
+/*
+ * The same work with the vectors in the usual block layout, one
+ * scatter per vector, one gather per sum and one MPI_Allreduce per
+ * dot product.  Returns the elapsed time, and the dot products in
+ * dots.
+ */
+double One_pair_at_a_time(
+    double dots[] /* out */,
+    int k /* in */,
+    int local_n /* in */,
+    int n /* in */,
+    int my_rank /* in */,
+    MPI_Comm comm /* in */)
+{
+    double *a = NULL, *z = NULL;
+    double *local_x, *local_y, *local_z;
+    double local_dot, tstart, tend;
+    int v, i;
+    int local_ok = 1;
+    char *fname = "One_pair_at_a_time";
+
+    local_x = malloc(local_n * sizeof(double));
+    local_y = malloc(local_n * sizeof(double));
+    local_z = malloc(local_n * sizeof(double));
+    if (local_x == NULL || local_y == NULL || local_z == NULL)
+        local_ok = 0;
+    if (my_rank == 0)
+    {
+        a = malloc(n * sizeof(double));
+        z = malloc(n * sizeof(double));
+        if (a == NULL || z == NULL)
+            local_ok = 0;
+    }
+    Check_for_error(local_ok, fname, "Can't allocate vectors", comm);
+
+    /* Take the page faults now, outside the timed region */
+    memset(local_x, 0, local_n * sizeof(double));
+    memset(local_y, 0, local_n * sizeof(double));
+    memset(local_z, 0, local_n * sizeof(double));
+    if (my_rank == 0)
+    {
+        memset(a, 0, n * sizeof(double));
+        memset(z, 0, n * sizeof(double));
+    }
+
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    for (v = 0; v < k; v++)
+    {
+        if (my_rank == 0)
+            Fill_vector(a, n, v, 0);
+        MPI_Scatter(a, local_n, MPI_DOUBLE, local_x, local_n, MPI_DOUBLE,
+                    0, comm);
+        if (my_rank == 0)
+            Fill_vector(a, n, v, 1);
+        MPI_Scatter(a, local_n, MPI_DOUBLE, local_y, local_n, MPI_DOUBLE,
+                    0, comm);
+
+        local_dot = 0.0;
+        for (i = 0; i < local_n; i++)
+        {
+            local_z[i] = local_x[i] + local_y[i];
+            local_dot += local_x[i] * local_y[i];
+        }
+        MPI_Allreduce(&local_dot, &dots[v], 1, MPI_DOUBLE, MPI_SUM,
+                      comm);
+        MPI_Gather(local_z, local_n, MPI_DOUBLE, z, local_n, MPI_DOUBLE, 0,
+                   comm);
+    }
+    tend = MPI_Wtime();
+
+    free(local_x);
+    free(local_y);
+    free(local_z);
+    free(a);
+    free(z);
+    return tend - tstart;
+} /* One_pair_at_a_time */
+
+/*
+ * Print the largest relative difference between the batched and the
+ * one-pair dot products.  They add the products in different orders,
+ * so they can differ in the last bits.
+ */
+void Check_dots(
+    double dots[] /* in */,
+    double pair_dots[] /* in */,
+    int k /* in */)
+{
+    double diff, max_diff = 0.0;
+    int v;
+
+    for (v = 0; v < k; v++)
+    {
+        diff = fabs(dots[v] - pair_dots[v]) /
+               (fabs(pair_dots[v]) > 0.0 ? fabs(pair_dots[v]) : 1.0);
+        if (diff > max_diff)
+            max_diff = diff;
+    }
+    printf("Largest relative difference from the one-pair dot products:"
+           "  %.2e%s\n", max_diff, max_diff > 1e-12 ? "  (MISMATCH)" : "");
+} /* Check_dots */
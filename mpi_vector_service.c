@@ -0,0 +1,481 @@
+/*
+ * Compile:  mpicc -O2 mpi_vector_service.c -o mpi_vector_service
+ * Run:      mpiexec -n N ./mpi_vector_service [spool directory]
+ *
+ * Resident version of the vector programs.  The processes start once,
+ * allocate and pre-fault buffers for the largest order they will be
+ * asked for, generate x and y, and then serve requests until told to
+ * quit, so a job doesn't pay for mpiexec, MPI_Init, the page faults
+ * and rand() again.
+ *
+ * Process 0 polls the spool directory (default "vector_spool") for
+ * files ending in ".req", taking them in name order.  A request file
+ * holds one line:
+ *
+ *     sum <n>          z = x + y on the first n elements
+ *     dot <n>          x . y on the first n elements
+ *     scale <n> <s>    z = s*x on the first n elements
+ *     quit
+ *
+ * n must be evenly divisible by comm_sz and at most the maximum order.
+ * Clients should write the file under another name and rename() it to
+ * *.req, so process 0 never reads a half-written request.  Process 0
+ * removes the request, broadcasts it, and writes the result to
+ * <name>.out in the same directory, in the same way:  to <name>.tmp
+ * first and then renamed, so a client polling for <name>.out never
+ * reads half of it.  The spool directory has to exist when the
+ * service starts.
+ *
+ * The latency of a request is what a client waits for once the request
+ * is there:  from the directory scan that finds it to the rename of
+ * its response, including the broadcast and the file I/O.  It is
+ * printed by process 0 next to the cold start measured when the
+ * service came up:  MPI_Init plus allocating, pre-faulting and
+ * generating the vectors, scaled to the request's n, plus the same
+ * latency.  The mpiexec launch itself happens before the program runs
+ * and can't be measured from inside it, so the real cold start is
+ * larger.
+ *
+ * While no request is pending all processes sleep between polls
+ * instead of spinning in MPI_Bcast.  The sleep starts at POLL_MIN us
+ * after each request and doubles with every empty poll up to
+ * POLL_MAX us, so requests that arrive back to back are picked up
+ * within a fraction of a millisecond while an idle service wakes up
+ * rarely.  The other processes only see a request when they next test
+ * the broadcast, so the latency includes up to one poll interval of
+ * wake-up delay, and the time a request waits in the directory before
+ * the scan that finds it isn't counted at all.  Each latency is
+ * printed with process 0's poll interval when it found the request,
+ * which bounds both:  latencies measured right after an idle period
+ * can be up to POLL_MAX us larger than under load.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <mpi.h>
+
+#define SPOOL_DIR      "vector_spool"
+#define REQ_SUFFIX     ".req"
+#define OUT_SUFFIX     ".out"
+#define TMP_SUFFIX     ".tmp"
+#define MAX_PATH       1024
+#define POLL_MIN       100   /* us */
+#define POLL_MAX       10000 /* us */
+
+typedef enum { OP_NONE, OP_SUM, OP_DOT, OP_SCALE, OP_QUIT } Op;
+
+/* What process 0 broadcasts for each request */
+typedef struct
+{
+    int op, n;
+    double scalar;
+} Request;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+                     MPI_Comm comm);
+void Check_spool(char spool[], int my_rank, MPI_Comm comm);
+void Read_max_n(int *max_n_p, int *max_local_n_p, int my_rank,
+                int comm_sz, MPI_Comm comm);
+void Allocate_vectors(double **local_x_pp, double **local_y_pp,
+                      double **local_z_pp, int local_n, MPI_Comm comm);
+void Generate_random_vector(double local_a[], int local_n);
+void Sleep_us(int us);
+int Next_request(char spool[], char name[]);
+void Parse_request(char path[], Request *req_p);
+void Wait_for_request(char spool[], char name[], Request *req_p,
+                      double *pickup_p, int *poll_p, int max_n,
+                      int my_rank, MPI_Comm comm);
+double Serve_request(Request *req_p, double local_x[], double local_y[],
+                     double local_z[], int comm_sz, MPI_Comm comm);
+void Write_response(char spool[], char name[], Request *req_p,
+                    double result);
+
+/*-------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+    int max_n, max_local_n, poll, served = 0;
+    int comm_sz, my_rank;
+    double *local_x, *local_y, *local_z;
+    double local_time, init_time, setup_time, tstart, pickup, latency;
+    double result;
+    double total_latency = 0.0, cold;
+    struct timespec before_init, after_init;
+    char *spool = argc > 1 ? argv[1] : SPOOL_DIR;
+    char name[MAX_PATH];
+    Request req;
+    MPI_Comm comm;
+
+    clock_gettime(CLOCK_MONOTONIC, &before_init);
+    MPI_Init(&argc, &argv);
+    clock_gettime(CLOCK_MONOTONIC, &after_init);
+    comm = MPI_COMM_WORLD;
+    MPI_Comm_size(comm, &comm_sz);
+    MPI_Comm_rank(comm, &my_rank);
+
+    local_time = (after_init.tv_sec - before_init.tv_sec) +
+                 (after_init.tv_nsec - before_init.tv_nsec) / 1e9;
+    MPI_Allreduce(&local_time, &init_time, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    Check_spool(spool, my_rank, comm);
+    Read_max_n(&max_n, &max_local_n, my_rank, comm_sz, comm);
+
+    /* The work a cold run repeats for every job */
+    MPI_Barrier(comm);
+    tstart = MPI_Wtime();
+    Allocate_vectors(&local_x, &local_y, &local_z, max_local_n, comm);
+    srand(time(NULL) + my_rank);
+    Generate_random_vector(local_x, max_local_n);
+    Generate_random_vector(local_y, max_local_n);
+    memset(local_z, 0, max_local_n * sizeof(double));
+    local_time = MPI_Wtime() - tstart;
+    MPI_Allreduce(&local_time, &setup_time, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    if (my_rank == 0)
+    {
+        printf("Serving requests from %s/*%s\n", spool, REQ_SUFFIX);
+        printf("Cold start:  MPI_Init %.3f ms, buffers %.3f ms "
+               "for n = %d\n", init_time * 1000, setup_time * 1000, max_n);
+        fflush(stdout);
+    }
+
+    for (;;)
+    {
+        Wait_for_request(spool, name, &req, &pickup, &poll, max_n,
+                         my_rank, comm);
+        if (req.op == OP_QUIT)
+            break;
+
+        result = Serve_request(&req, local_x, local_y, local_z, comm_sz,
+                               comm);
+
+        if (my_rank == 0)
+        {
+            Write_response(spool, name, &req, result);
+            latency = MPI_Wtime() - pickup;
+            cold = init_time + setup_time * req.n / max_n + latency;
+            printf("%s:  %.3f ms  (cold start %.3f ms, %.1fx, "
+                   "poll %.1f ms)\n", name, latency * 1000, cold * 1000,
+                   cold / latency, poll / 1000.0);
+            fflush(stdout);
+            total_latency += latency;
+        }
+        served++;
+    }
+
+    if (my_rank == 0 && served > 0)
+        printf("Served %d requests, mean latency %.3f ms\n", served,
+               total_latency / served * 1000);
+
+    free(local_x);
+    free(local_y);
+    free(local_z);
+
+    MPI_Finalize();
+
+    return 0;
+} /* main */
+
+void Check_for_error(
+    int local_ok /* in */,
+    char fname[] /* in */,
+    char message[] /* in */,
+    MPI_Comm comm /* in */)
+{
+    int ok;
+
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (ok == 0)
+    {
+        int my_rank;
+        MPI_Comm_rank(comm, &my_rank);
+        if (my_rank == 0)
+        {
+            fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+                    message);
+            fflush(stderr);
+        }
+        MPI_Finalize();
+        exit(-1);
+    }
+} /* Check_for_error */
+
+/* Process 0 checks that the spool directory exists */
+void Check_spool(
+    char spool[] /* in */,
+    int my_rank /* in */,
+    MPI_Comm comm /* in */)
+{
+    struct stat st;
+    int local_ok = 1;
+    char message[2 * MAX_PATH];
+
+    if (my_rank == 0 && (stat(spool, &st) != 0 || !S_ISDIR(st.st_mode)))
+        local_ok = 0;
+    snprintf(message, sizeof(message), "spool directory %s doesn't exist",
+             spool);
+    Check_for_error(local_ok, "Check_spool", message, comm);
+} /* Check_spool */
+
+void Read_max_n(
+    int *max_n_p /* out */,
+    int *max_local_n_p /* out */,
+    int my_rank /* in  */,
+    int comm_sz /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Read_max_n";
+
+    if (my_rank == 0)
+    {
+        printf("What's the maximum order of the vectors?\n");
+        scanf("%d", max_n_p);
+    }
+    MPI_Bcast(max_n_p, 1, MPI_INT, 0, comm);
+    if (*max_n_p <= 0 || *max_n_p % comm_sz != 0)
+        local_ok = 0;
+    Check_for_error(local_ok, fname,
+                    "n should be > 0 and evenly divisible by comm_sz", comm);
+    *max_local_n_p = *max_n_p / comm_sz;
+} /* Read_max_n */
+
+void Allocate_vectors(
+    double **local_x_pp /* out */,
+    double **local_y_pp /* out */,
+    double **local_z_pp /* out */,
+    int local_n /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_ok = 1;
+    char *fname = "Allocate_vectors";
+
+    *local_x_pp = malloc(local_n * sizeof(double));
+    *local_y_pp = malloc(local_n * sizeof(double));
+    *local_z_pp = malloc(local_n * sizeof(double));
+
+    if (*local_x_pp == NULL || *local_y_pp == NULL || *local_z_pp == NULL)
+        local_ok = 0;
+    Check_for_error(local_ok, fname, "Can't allocate local vector(s)",
+                    comm);
+} /* Allocate_vectors */
+
+void Generate_random_vector(
+    double local_a[] /* out */,
+    int local_n /* in  */)
+{
+    int i;
+
+    for (i = 0; i < local_n; i++)
+        local_a[i] = (double)rand() / (double)RAND_MAX;
+} /* Generate_random_vector */
+
+void Sleep_us(int us /* in */)
+{
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000L;
+    nanosleep(&ts, NULL);
+} /* Sleep_us */
+
+/*
+ * Find the pending request with the smallest name.  Returns 0 if
+ * there is none.
+ */
+int Next_request(
+    char spool[] /* in  */,
+    char name[] /* out */)
+{
+    DIR *dir;
+    struct dirent *entry;
+    size_t len, suffix_len = strlen(REQ_SUFFIX);
+    int found = 0;
+
+    dir = opendir(spool);
+    if (dir == NULL)
+        return 0;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        len = strlen(entry->d_name);
+        if (len <= suffix_len || len >= MAX_PATH ||
+            strcmp(entry->d_name + len - suffix_len, REQ_SUFFIX) != 0)
+            continue;
+        if (!found || strcmp(entry->d_name, name) < 0)
+        {
+            strcpy(name, entry->d_name);
+            found = 1;
+        }
+    }
+    closedir(dir);
+    return found;
+} /* Next_request */
+
+/* A request that can't be parsed is returned as OP_NONE */
+void Parse_request(
+    char path[] /* in  */,
+    Request *req_p /* out */)
+{
+    FILE *fp;
+    char op[16];
+    int fields = 0;
+
+    req_p->op = OP_NONE;
+    req_p->n = 0;
+    req_p->scalar = 0.0;
+
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return;
+    fields = fscanf(fp, "%15s %d %lf", op, &req_p->n, &req_p->scalar);
+    fclose(fp);
+
+    if (fields >= 1 && strcmp(op, "quit") == 0)
+        req_p->op = OP_QUIT;
+    else if (fields >= 2 && strcmp(op, "sum") == 0)
+        req_p->op = OP_SUM;
+    else if (fields >= 2 && strcmp(op, "dot") == 0)
+        req_p->op = OP_DOT;
+    else if (fields >= 3 && strcmp(op, "scale") == 0)
+        req_p->op = OP_SCALE;
+} /* Parse_request */
+
+/*
+ * Process 0 polls the spool directory, the others poll the broadcast,
+ * until a request arrives.  Invalid requests are answered by process
+ * 0 alone and never reach the other processes.  On process 0 pickup_p
+ * is the MPI_Wtime() of the scan that found the request, and poll_p
+ * the sleep between polls, in us, when it was found.  Every wait starts
+ * polling every POLL_MIN us and doubles the sleep up to POLL_MAX us.
+ */
+void Wait_for_request(
+    char spool[] /* in  */,
+    char name[] /* out */,
+    Request *req_p /* out */,
+    double *pickup_p /* out */,
+    int *poll_p /* out */,
+    int max_n /* in  */,
+    int my_rank /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    char path[2 * MAX_PATH];
+    int comm_sz, done = 0, poll = POLL_MIN;
+    MPI_Request bcast_req;
+
+    MPI_Comm_size(comm, &comm_sz);
+    if (my_rank == 0)
+    {
+        for (;;)
+        {
+            *pickup_p = MPI_Wtime();
+            *poll_p = poll;
+            if (!Next_request(spool, name))
+            {
+                Sleep_us(poll);
+                poll = 2 * poll < POLL_MAX ? 2 * poll : POLL_MAX;
+                continue;
+            }
+            snprintf(path, sizeof(path), "%s/%s", spool, name);
+            Parse_request(path, req_p);
+            remove(path);
+            if (req_p->op == OP_QUIT ||
+                (req_p->op != OP_NONE && req_p->n > 0 &&
+                 req_p->n <= max_n && req_p->n % comm_sz == 0))
+                break;
+            req_p->op = OP_NONE;
+            Write_response(spool, name, req_p, 0.0);
+        }
+        poll = POLL_MIN; /* the root's side of the broadcast is due now */
+    }
+
+    MPI_Ibcast(req_p, sizeof(Request), MPI_BYTE, 0, comm, &bcast_req);
+    MPI_Test(&bcast_req, &done, MPI_STATUS_IGNORE);
+    while (!done)
+    {
+        Sleep_us(poll);
+        poll = 2 * poll < POLL_MAX ? 2 * poll : POLL_MAX;
+        MPI_Test(&bcast_req, &done, MPI_STATUS_IGNORE);
+    }
+} /* Wait_for_request */
+
+/*
+ * Run one request on the first n/comm_sz elements of each process'
+ * block.  Returns the checksum of z, or the dot product.
+ */
+double Serve_request(
+    Request *req_p /* in  */,
+    double local_x[] /* in  */,
+    double local_y[] /* in  */,
+    double local_z[] /* out */,
+    int comm_sz /* in  */,
+    MPI_Comm comm /* in  */)
+{
+    int local_n = req_p->n / comm_sz;
+    int local_i;
+    double local_sum = 0.0, sum;
+
+    switch (req_p->op)
+    {
+    case OP_SUM:
+        for (local_i = 0; local_i < local_n; local_i++)
+        {
+            local_z[local_i] = local_x[local_i] + local_y[local_i];
+            local_sum += local_z[local_i];
+        }
+        break;
+    case OP_DOT:
+        for (local_i = 0; local_i < local_n; local_i++)
+            local_sum += local_x[local_i] * local_y[local_i];
+        break;
+    case OP_SCALE:
+        for (local_i = 0; local_i < local_n; local_i++)
+        {
+            local_z[local_i] = req_p->scalar * local_x[local_i];
+            local_sum += local_z[local_i];
+        }
+        break;
+    }
+    MPI_Allreduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return sum;
+} /* Serve_request */
+
+/*
+ * Write <name>.out through <name>.tmp and rename(), so it appears
+ * complete.  OP_NONE marks a rejected request.
+ */
+void Write_response(
+    char spool[] /* in */,
+    char name[] /* in */,
+    Request *req_p /* in */,
+    double result /* in */)
+{
+    char path[2 * MAX_PATH], tmp_path[2 * MAX_PATH];
+    int base_len = strlen(name) - strlen(REQ_SUFFIX);
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/%.*s%s", spool, base_len, name,
+             OUT_SUFFIX);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/%.*s%s", spool, base_len,
+             name, TMP_SUFFIX);
+    fp = fopen(tmp_path, "w");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Can't write %s\n", tmp_path);
+        return;
+    }
+    if (req_p->op == OP_NONE)
+        fprintf(fp, "error: invalid request\n");
+    else
+        fprintf(fp, "%s %d %.17g\n",
+                req_p->op == OP_DOT ? "dot" :
+                req_p->op == OP_SUM ? "sum" : "scale",
+                req_p->n, result);
+    if (fclose(fp) != 0 || rename(tmp_path, path) != 0)
+    {
+        fprintf(stderr, "Can't write %s\n", path);
+        remove(tmp_path);
+    }
+} /* Write_response */
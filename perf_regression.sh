@@ -0,0 +1,313 @@
+#!/bin/bash
+#
+# Run:      ./perf_regression.sh [case ...]            compare against
+#                                                      perf_baseline.txt
+#           ./perf_regression.sh --update [case ...]   record the baseline
+#
+# Without case names every case in CASES is run.  With --update only
+# the baselines of the cases and process counts that were run are
+# replaced, and without it only their kernels are compared.
+#
+# Performance regression suite for the programs in this directory.
+# Every case in CASES is compiled with its flags and run RUNS times
+# on each process count in RANKS (serial programs only on 1), with the
+# same input each time.  Every timing line the program prints ("...
+# 1.234 ms", "Took ... seconds to run", ...) becomes a kernel, named
+# <case>/np<ranks>/<label>, and is summarized by its mean and 95%
+# confidence interval over the runs.
+#
+# A kernel has regressed when its mean time is above the baseline mean
+# by more than both confidence intervals together (so the difference
+# isn't noise) and by more than THRESHOLD of the baseline mean (so it
+# matters).  Differences under FLOOR_MS are never reported.  Load on
+# the machine moves the timings between sessions by more than the
+# confidence intervals of one session show, so the cases with a
+# regressed kernel are run again, and only kernels that still regress
+# in the new runs count.  The suite prints a per-kernel report and
+# exits with status 1 if any kernel has regressed or disappeared.
+#
+# The baseline is only meaningful on the machine that recorded it:
+# after changing machines, run with --update on the old tree first.
+#
+# Environment:
+#   RUNS=5  RANKS="1 2 4"  THRESHOLD=0.20  FLOOR_MS=0.05
+#   MPIEXEC=mpiexec  MPIEXEC_FLAGS=  (e.g. "--oversubscribe")
+#   MPICC=mpicc  CFLAGS="-O3"  BASELINE=perf_baseline.txt
+#
+
+set -u
+
+cd "$(dirname "$0")"
+
+RUNS=${RUNS:-5}
+RANKS=${RANKS:-"1 2 4"}
+THRESHOLD=${THRESHOLD:-0.20}
+FLOOR_MS=${FLOOR_MS:-0.05}
+MPIEXEC=${MPIEXEC:-mpiexec}
+MPIEXEC_FLAGS=${MPIEXEC_FLAGS:-}
+MPICC=${MPICC:-mpicc}
+CFLAGS=${CFLAGS:-"-O3"}
+BASELINE=${BASELINE:-perf_baseline.txt}
+
+# The input is fed to stdin one comma-separated value per line, or
+# nothing for "-":  mpi_vector_add.c has n = 10000000 built in.
+# add_tuned runs with the choice in mpi_vector_add.tune.<host>, and
+# tunes and saves it on its first run if there's none.  "vectors:<n>"
+# is n followed by two vectors of n random numbers, the same each run.
+#
+# name         source                        flags              mode    input
+CASES="
+add            mpi_vector_add.c              -                  mpi     -
+add_hier       mpi_vector_add.c              -DHIERARCHICAL     mpi     -
+add_wire       mpi_vector_add.c              -DWIRE_COMPRESSION mpi     -
+add_dist       mpi_vector_add.c              -DDIST_BENCH       mpi     -
+add_tuned      mpi_vector_add.c              -DAUTOTUNE         mpi     -
+add2           mpi_vector_add2.c             -                  mpi     4000000
+dot_scalar     mpi_vector_add_dot_scalar.c   -                  mpi     4000000,3
+dot_lowmem     mpi_vector_add_dot_scalar.c   -DLOW_MEMORY       mpi     4000000,3
+sparse         mpi_sparse_vector.c           -                  mpi     4000000,0.1
+batch          mpi_vector_batch.c            -                  mpi     400000,8
+dynamic        mpi_vector_add_dynamic.c      -                  mpi     4000000
+mat_vect       mpi_mat_vect_mult.c           -                  mpi     2000,2000
+serial_add     vector_add.c                  -                  serial  vectors:1000000
+serial_add2    vector_add2.c                 -                  serial  4000000
+"
+
+update=0
+if [ "${1:-}" = --update ]
+then
+    update=1
+    shift
+fi
+only=" $* "
+for name in "$@"
+do
+    if ! echo "$CASES" | grep -q "^$name "
+    then
+        echo "usage: $0 [--update] [case ...]" >&2
+        echo "unknown case $name" >&2
+        exit 2
+    fi
+done
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Turn a program's output into "<label> <ms>" lines.  A timing is a
+# number followed by ms, seconds or segundos; its label is the text
+# before it (minus "took"), or the last heading without digits for
+# lines like "   Took 4.2 ms, imbalance 1.05", or "total" for "Took ...
+# to run".  Lines of more than 100 fields are printed vectors and
+# are skipped.
+extract='
+function emit(label, ms) {
+    label = tolower(label)
+    gsub(/took/, "", label)
+    gsub(/[^a-z0-9]+/, "_", label)
+    gsub(/^_+|_+$/, "", label)
+    if (label == "")
+        label = /to run/ ? "total" : heading
+    print label, ms
+}
+/^ *Proc [0-9]+:/ { next }
+NF > 100 { next }
+!/[0-9]/ {
+    h = tolower($0); gsub(/[^a-z0-9]+/, "_", h); gsub(/^_+|_+$/, "", h)
+    heading = h
+    next
+}
+{
+    label = ""
+    for (i = 1; i < NF; i++) {
+        unit = $(i + 1); sub(/[,;]$/, "", unit)
+        if ($i ~ /^[0-9]+(\.[0-9]+)?$/ &&
+            (unit == "ms" || unit == "seconds" || unit == "segundos")) {
+            emit(label, unit == "ms" ? $i : $i * 1000)
+            label = ""
+            i++
+        } else
+            label = label " " $i
+    }
+}'
+
+# Mean and 95% confidence half-width of "<key> <ms>" lines, per key
+summarize='
+{ n[$1]++; s[$1] += $2; ss[$1] += $2 * $2 }
+END {
+    split("12.706 4.303 3.182 2.776 2.571 2.447 2.365 2.306 2.262", t)
+    for (k in n) {
+        mean = s[k] / n[k]
+        var = n[k] > 1 ? (ss[k] - n[k] * mean * mean) / (n[k] - 1) : 0
+        if (var < 0) var = 0
+        tq = n[k] - 1 in t ? t[n[k] - 1] : 1.96
+        printf "%s %.4f %.4f %d\n", k, mean, tq * sqrt(var / n[k]), n[k]
+    }
+}'
+
+# Compile the cases listed in the file $1 and run each RUNS times on
+# every process count, appending "<kernel> <ms>" lines to the file $2
+# and a "<case>/np<ranks>" line per process count to the file $3
+run_cases()
+{
+    echo "$CASES" | while read -r name src flags mode input
+    do
+        [ -z "$name" ] && continue
+        grep -qx "$name" "$1" || continue
+        [ "$flags" = "-" ] && flags=""
+        [ "$input" = "-" ] && input=""
+        case $input in
+        vectors:*)
+            awk -v n="${input#vectors:}" 'BEGIN {
+                srand(1)
+                print n
+                for (i = 0; i < 2 * n; i++)
+                    printf "%.6f\n", 2000 * rand() - 1000
+            }' > "$work/$name.in"
+            ;;
+        *)
+            printf "%s" "$input" | tr , '\n' > "$work/$name.in"
+            ;;
+        esac
+        bin=$work/$name
+        if ! $MPICC $CFLAGS $flags "$src" -o "$bin" -lm 2> "$work/cc.log"
+        then
+            echo "$name:  compile failed" >&2
+            cat "$work/cc.log" >&2
+            exit 1
+        fi
+
+        ranks=$RANKS
+        [ "$mode" = serial ] && ranks=1
+        for np in $ranks
+        do
+            printf "%-12s np=%-2s " "$name" "$np" >&2
+            for run in $(seq "$RUNS")
+            do
+                if [ "$mode" = serial ]
+                then
+                    "$bin" < "$work/$name.in" > "$work/out.txt" 2>&1
+                else
+                    $MPIEXEC $MPIEXEC_FLAGS -n "$np" "$bin" \
+                        < "$work/$name.in" > "$work/out.txt" 2>&1
+                fi
+                if [ $? -ne 0 ]
+                then
+                    echo "failed:" >&2
+                    cat "$work/out.txt" >&2
+                    exit 1
+                fi
+                awk "$extract" "$work/out.txt" |
+                    awk -v p="$name/np$np/" '{ print p $1, $2 }' >> "$2"
+                printf "." >&2
+            done
+            echo >&2
+            echo "$name/np$np" >> "$3"
+        done
+    done
+}
+
+# Print the per-kernel report for the summaries in the file $1 against
+# the baseline lines of the "<case>/np<ranks>" runs listed in the file
+# $2.  Returns 1 if any kernel regressed or is missing.
+compare()
+{
+    grep -v '^#' "$BASELINE" |
+        awk 'FNR == NR { ran[$1] = 1; next }
+             { split($1, k, "/") } k[1] "/" k[2] in ran' "$2" - |
+        awk -v threshold="$THRESHOLD" -v floor="$FLOOR_MS" '
+    FNR == NR { bmean[$1] = $2; bci[$1] = $3; next }
+    {
+        cur[$1] = 1
+        if (!($1 in bmean)) {
+            printf "%-44s %10s %10.3f %8s  new\n", $1, "-", $2, "-"
+            next
+        }
+        diff = $2 - bmean[$1]
+        noise = bci[$1] + $3
+        change = bmean[$1] > 0 ? 100 * diff / bmean[$1] : 0
+        verdict = "ok"
+        if (diff > noise && diff > threshold * bmean[$1] && diff > floor) {
+            verdict = "REGRESSED"
+            failed++
+        } else if (-diff > noise && -diff > threshold * bmean[$1] &&
+                   -diff > floor)
+            verdict = "improved"
+        printf "%-44s %10.3f %10.3f %+7.1f%%  %s\n", $1, bmean[$1], $2,
+               change, verdict
+    }
+    END {
+        for (k in bmean)
+            if (!(k in cur)) {
+                printf "%-44s %10.3f %10s %8s  MISSING\n", k, bmean[k], "-",
+                       "-"
+                failed++
+            }
+        if (failed > 0) {
+            printf "\n%d kernel(s) regressed or missing\n", failed
+            exit 1
+        }
+        printf "\nNo regressions\n"
+    }' - "$1"
+}
+
+echo "$CASES" | while read -r name rest
+do
+    [ -z "$name" ] && continue
+    [ "$only" != "  " ] && [ "${only#* $name }" = "$only" ] && continue
+    echo "$name"
+done > "$work/cases.txt"
+
+: > "$work/samples.txt"
+: > "$work/runs.txt"
+run_cases "$work/cases.txt" "$work/samples.txt" "$work/runs.txt" || exit 1
+awk "$summarize" "$work/samples.txt" | sort > "$work/current.txt"
+
+if [ $update -eq 1 ]
+then
+    {
+        echo "# kernel mean_ms ci95_ms runs"
+        echo "# Recorded on $(hostname) by perf_regression.sh --update"
+        {
+            [ -f "$BASELINE" ] && grep -v '^#' "$BASELINE" |
+                awk 'FNR == NR { ran[$1] = 1; next }
+                     { split($1, k, "/") } !(k[1] "/" k[2] in ran)' \
+                    "$work/runs.txt" -
+            cat "$work/current.txt"
+        } | sort
+    } > "$BASELINE.new" && mv "$BASELINE.new" "$BASELINE"
+    echo "Wrote $(wc -l < "$work/current.txt") kernels to $BASELINE"
+    exit 0
+fi
+
+if [ ! -f "$BASELINE" ]
+then
+    echo "No baseline $BASELINE, run with --update first" >&2
+    exit 2
+fi
+
+# A slowdown has to show up again in a second set of runs of its case
+# before it counts, so a burst of load on the machine doesn't fail the
+# suite
+compare "$work/current.txt" "$work/runs.txt" > "$work/report.txt"
+status=$?
+awk '$NF == "REGRESSED" { split($1, k, "/"); print k[1] }' \
+    "$work/report.txt" | sort -u > "$work/retry.txt"
+if [ -s "$work/retry.txt" ]
+then
+    echo "Confirming $(tr '\n' ' ' < "$work/retry.txt")" >&2
+    : > "$work/retry_samples.txt"
+    run_cases "$work/retry.txt" "$work/retry_samples.txt" /dev/null ||
+        exit 1
+    {
+        awk 'FNR == NR { retry[$1] = 1; next }
+             { split($1, k, "/") } !(k[1] in retry)' \
+            "$work/retry.txt" "$work/current.txt"
+        awk "$summarize" "$work/retry_samples.txt"
+    } | sort > "$work/confirmed.txt"
+    compare "$work/confirmed.txt" "$work/runs.txt" > "$work/report.txt"
+    status=$?
+fi
+
+printf "%-44s %10s %10s %8s\n" "kernel" "base ms" "now ms" "change"
+cat "$work/report.txt"
+exit $status
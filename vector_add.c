@@ -2,43 +2,86 @@
  *
  * Purpose:  Implement vector addition
  *
- * Compile:  gcc -g -Wall -o vector_add vector_add.c
+ * Compile:  gcc -O2 -Wall -o vector_add vector_add.c -lm
  * Run:      ./vector_add
  *
  * Input:    The order of the vectors, n, and the vectors x and y
  * Output:   The sum vector z = x+y
  *
  * Note:
- *    If the program detects an error (order of vector <= 0 or malloc
- * failure), it prints a message and terminates
+ *    If the program detects an error (order of vector <= 0, missing
+ * or malformed input, or malloc failure), it prints a message and
+ * terminates
+ *
+ *    The whole input is read at once and parsed with Parse_double,
+ * and the sum is formatted into OUT_BLOCK byte blocks by
+ * Format_fixed6, both of which give the same results as scanf("%lf")
+ * and printf("%f").  Since stdin is read up to end of file before
+ * anything is parsed, interactive input has to end with Ctrl-D.  The
+ * time and throughput of each phase are printed on stderr.
  *
  * IPP:      Section 3.4.6 (p. 109)
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define IN_CHUNK  (1 << 20)   /* bytes added to the input buffer at a time */
+#define OUT_BLOCK (1 << 20)   /* bytes of output written at a time         */
 
-void Read_n(int *n_p);
+char *Read_input(size_t *size_p);
+void Read_n(int *n_p, char **pos_p);
 void Allocate_vectors(double **x_pp, double **y_pp, double **z_pp, int n);
-void Read_vector(double a[], int n, char vec_name[]);
-void Print_vector(double b[], int n, char title[]);
+double Parse_double(char **pos_p);
+void Read_vector(double a[], int n, char vec_name[], char **pos_p);
+int Format_fixed6(double v, char out[]);
+size_t Print_vector(double b[], int n, char title[]);
 void Vector_sum(double x[], double y[], double z[], int n);
+double Elapsed(struct timespec *start_p);
 
 /*---------------------------------------------------------------------*/
 int main(void)
 {
    int n;
    double *x, *y, *z;
+   char *input, *pos;
+   size_t in_size, out_size;
+   double read_time, parse_time, sum_time, print_time;
+   struct timespec start;
 
-   Read_n(&n);
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   input = Read_input(&in_size);
+   read_time = Elapsed(&start);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   pos = input;
+   Read_n(&n, &pos);
    Allocate_vectors(&x, &y, &z, n);
 
-   Read_vector(x, n, "x");
-   Read_vector(y, n, "y");
+   Read_vector(x, n, "x", &pos);
+   Read_vector(y, n, "y", &pos);
+   parse_time = Elapsed(&start);
 
+   clock_gettime(CLOCK_MONOTONIC, &start);
    Vector_sum(x, y, z, n);
+   sum_time = Elapsed(&start);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   out_size = Print_vector(z, n, "The sum is");
+   print_time = Elapsed(&start);
 
-   Print_vector(z, n, "The sum is");
+   fprintf(stderr, "Read input   %10.3f ms  (%.1f MB/s)\n",
+           read_time * 1000, in_size / read_time / 1.0e6);
+   fprintf(stderr, "Parse        %10.3f ms  (%.1f MB/s)\n",
+           parse_time * 1000, in_size / parse_time / 1.0e6);
+   fprintf(stderr, "Vector_sum   %10.3f ms\n", sum_time * 1000);
+   fprintf(stderr, "Print        %10.3f ms  (%.1f MB/s)\n",
+           print_time * 1000, out_size / print_time / 1.0e6);
 
+   free(input);
    free(x);
    free(y);
    free(z);
@@ -46,22 +89,65 @@ int main(void)
    return 0;
 } /* main */
 
+/*---------------------------------------------------------------------
+ * Function:  Read_input
+ * Purpose:   Read all of stdin into one buffer
+ * Out arg:   size_p:  the number of bytes read
+ * Return:    the input followed by a '\0', for strtod
+ *
+ * Errors:    If the buffer can't be allocated, the program terminates
+ */
+char *Read_input(size_t *size_p /* out */)
+{
+   char *buf = NULL, *bigger;
+   size_t size = 0, capacity = 0, got;
+
+   do
+   {
+      if (capacity - size < IN_CHUNK + 1)
+      {
+         capacity = capacity == 0 ? 4 * IN_CHUNK : 2 * capacity;
+         bigger = realloc(buf, capacity);
+         if (bigger == NULL)
+         {
+            fprintf(stderr, "Can't allocate input buffer\n");
+            exit(-1);
+         }
+         buf = bigger;
+      }
+      got = fread(buf + size, 1, IN_CHUNK, stdin);
+      size += got;
+   } while (got > 0);
+
+   buf[size] = '\0';
+   *size_p = size;
+   return buf;
+} /* Read_input */
+
 /*---------------------------------------------------------------------
  * Function:  Read_n
- * Purpose:   Get the order of the vectors from stdin
+ * Purpose:   Get the order of the vectors from the input
+ * In/out arg:  pos_p:  the next character of the input
  * Out arg:   n_p:  the order of the vectors
  *
  * Errors:    If n <= 0, the program terminates
  */
-void Read_n(int *n_p /* out */)
+void Read_n(
+    int *n_p /* out */,
+    char **pos_p /* in/out */)
 {
+   char *end;
+   long n;
+
    printf("What's the order of the vectors?\n");
-   scanf("%d", n_p);
-   if (*n_p <= 0)
+   n = strtol(*pos_p, &end, 10);
+   if (end == *pos_p || n <= 0 || n > INT32_MAX)
    {
       fprintf(stderr, "Order should be positive\n");
       exit(-1);
    }
+   *pos_p = end;
+   *n_p = n;
 } /* Read_n */
 
 /*---------------------------------------------------------------------
@@ -88,41 +174,186 @@ void Allocate_vectors(
    }
 } /* Allocate_vectors */
 
+/*---------------------------------------------------------------------
+ * Function:  Parse_double
+ * Purpose:   Parse the next number in the input
+ * In/out arg:  pos_p:  the next character of the input
+ * Return:    the number, rounded like strtod
+ *
+ * Errors:    If there's no number, the program terminates
+ *
+ * Note:
+ *    Numbers of the form [sign]digits[.digits] whose digits make an
+ *    integer of at most 2^53, with at most 22 decimals, are converted
+ *    directly:  the digits and the power of ten are both exact
+ *    doubles, so dividing them rounds once, correctly.  Anything
+ *    else (exponents, long mantissas, inf, nan, hex) goes to strtod.
+ */
+double Parse_double(char **pos_p /* in/out */)
+{
+   static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+      1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+      1e18, 1e19, 1e20, 1e21, 1e22};
+   char *s = *pos_p, *digits, *end;
+   uint64_t mant = 0;
+   int neg = 0, decimals = 0;
+   double v;
+
+   while (*s == ' ' || (*s >= '\t' && *s <= '\r'))
+      s++;
+   *pos_p = s;
+   if (*s == '-' || *s == '+')
+      neg = *s++ == '-';
+
+   digits = s;
+   for (; *s >= '0' && *s <= '9' && mant < 10000000000000000ULL; s++)
+      mant = mant * 10 + (*s - '0');
+   if (*s == '.')
+      for (s++; *s >= '0' && *s <= '9' && mant < 10000000000000000ULL &&
+                decimals < 22; s++, decimals++)
+         mant = mant * 10 + (*s - '0');
+
+   /* Digits left over, an exponent or anything else after the number */
+   if (s == digits || (s == digits + 1 && *digits == '.') ||
+       mant > (1ULL << 53) ||
+       (*s != '\0' && *s != ' ' && (*s < '\t' || *s > '\r')))
+   {
+      v = strtod(*pos_p, &end);
+      if (end == *pos_p)
+      {
+         fprintf(stderr, "Expected a number in the input\n");
+         exit(-1);
+      }
+      *pos_p = end;
+      return v;
+   }
+
+   v = (double)mant / pow10[decimals];
+   *pos_p = s;
+   return neg ? -v : v;
+} /* Parse_double */
+
 /*---------------------------------------------------------------------
  * Function:  Read_vector
- * Purpose:   Read a vector from stdin
+ * Purpose:   Read a vector from the input
  * In args:   n:  order of the vector
  *            vec_name:  name of vector (e.g., x)
+ * In/out arg:  pos_p:  the next character of the input
  * Out arg:   a:  the vector to be read in
  */
 void Read_vector(
     double a[] /* out */,
     int n /* in  */,
-    char vec_name[] /* in  */)
+    char vec_name[] /* in  */,
+    char **pos_p /* in/out */)
 {
    int i;
    printf("Enter the vector %s\n", vec_name);
    for (i = 0; i < n; i++)
-      scanf("%lf", &a[i]);
+      a[i] = Parse_double(pos_p);
 } /* Read_vector */
 
+/*---------------------------------------------------------------------
+ * Function:  Format_fixed6
+ * Purpose:   Write v the way printf("%f") does, without the '\0'
+ * In arg:    v:  the number
+ * Out arg:   out:  the text, at least 32 chars, or enough for
+ *                  printf("%f") if |v| >= 1e15
+ * Return:    the length of the text
+ *
+ * Note:
+ *    The fraction is scaled by 1e6 and rounded to an integer.  The
+ *    scaling can be off by about 1e-10, which only matters when the
+ *    exact value is next to a rounding tie, so printf formats those,
+ *    along with large values, inf and nan.
+ */
+int Format_fixed6(
+    double v /* in  */,
+    char out[] /* out */)
+{
+   char digits[24];
+   double a = fabs(v), scaled, rest;
+   uint64_t ip;
+   uint32_t frac;
+   int len = 0, d = 0, i;
+
+   if (!(a < 1e15))
+      return sprintf(out, "%f", v);
+
+   ip = (uint64_t)a;
+   scaled = (a - ip) * 1e6;
+   frac = (uint32_t)scaled;
+   rest = scaled - frac;
+   if (fabs(rest - 0.5) < 1e-6)
+      return sprintf(out, "%f", v);
+   if (rest > 0.5 && ++frac == 1000000)
+   {
+      frac = 0;
+      ip++;
+   }
+
+   if (signbit(v))
+      out[len++] = '-';
+   do
+   {
+      digits[d++] = '0' + ip % 10;
+      ip /= 10;
+   } while (ip > 0);
+   while (d > 0)
+      out[len++] = digits[--d];
+   out[len++] = '.';
+   for (i = 5; i >= 0; i--)
+   {
+      out[len + i] = '0' + frac % 10;
+      frac /= 10;
+   }
+   return len + 6;
+} /* Format_fixed6 */
+
 /*---------------------------------------------------------------------
  * Function:  Print_vector
  * Purpose:   Print the contents of a vector
  * In args:   b:  the vector to be printed
  *            n:  the order of the vector
  *            title:  title for print out
+ * Return:    the number of bytes printed
  */
-void Print_vector(
+size_t Print_vector(
     double b[] /* in */,
     int n /* in */,
     char title[] /* in */)
 {
+   char *block;
+   size_t used = 0, total;
    int i;
-   printf("%s\n", title);
+
+   /* The fallback to printf can take up to 1e308's digits */
+   block = malloc(OUT_BLOCK + 512);
+   if (block == NULL)
+   {
+      fprintf(stderr, "Can't allocate output buffer\n");
+      exit(-1);
+   }
+
+   total = printf("%s\n", title);
    for (i = 0; i < n; i++)
-      printf("%f ", b[i]);
-   printf("\n");
+   {
+      used += Format_fixed6(b[i], block + used);
+      block[used++] = ' ';
+      if (used >= OUT_BLOCK)
+      {
+         fwrite(block, 1, used, stdout);
+         total += used;
+         used = 0;
+      }
+   }
+   block[used++] = '\n';
+   fwrite(block, 1, used, stdout);
+   total += used;
+   fflush(stdout);
+
+   free(block);
+   return total;
 } /* Print_vector */
 
 /*---------------------------------------------------------------------
@@ -143,4 +374,18 @@ void Vector_sum(
 
    for (i = 0; i < n; i++)
       z[i] = x[i] + y[i];
-} /* Vector_sum */
\ No newline at end of file
+} /* Vector_sum */
+
+/*---------------------------------------------------------------------
+ * Function:  Elapsed
+ * Purpose:   Seconds since *start_p
+ * In arg:    start_p:  a time from clock_gettime(CLOCK_MONOTONIC)
+ */
+double Elapsed(struct timespec *start_p /* in */)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (now.tv_sec - start_p->tv_sec) +
+          (now.tv_nsec - start_p->tv_nsec) / 1.0e9;
+} /* Elapsed */